@@ -0,0 +1,43 @@
+#ifndef COMPRESSIONPOLICY_H
+#define COMPRESSIONPOLICY_H
+
+#include <QByteArray>
+
+// How hard each part of a .docx package is compressed.
+//
+// Pictures arrive as PNG, JPEG or GIF, which are compressed already:
+// deflating them again saves nothing and costs as much CPU as the rest of
+// the save, so they are stored. Other parts are judged from a small
+// sample: near-random data is stored too, and everything else is deflated
+// at a level chosen by the user's Mode.
+namespace CompressionPolicy {
+
+enum class Mode {
+    SmallFile,   // the default: level 6, as before the policy existed
+    FastSave,    // level 1: several times faster, XML parts ~50% bigger
+};
+
+// The mode .docx export uses. Safe to call from any thread.
+Mode mode();
+void setMode(Mode mode);
+
+// "small" / "fast", and back (SmallFile if not recognised)
+QByteArray modeName(Mode mode);
+Mode modeFromName(const QByteArray &name);
+
+// Order-0 entropy, in bits per byte (0 to 8), of a few evenly spread
+// windows of `data`. Cheap enough to run on every part.
+double sampleEntropy(const char *data, qsizetype size);
+
+// The deflate level for a part: 0 means store it. `alreadyCompressed` is
+// for contents known to be compressed (an image container).
+int levelFor(const char *data, qsizetype size, bool alreadyCompressed,
+             Mode mode = CompressionPolicy::mode());
+inline int levelFor(const QByteArray &data, bool alreadyCompressed,
+                    Mode mode = CompressionPolicy::mode()) {
+    return levelFor(data.constData(), data.size(), alreadyCompressed, mode);
+}
+
+} // namespace CompressionPolicy
+
+#endif // COMPRESSIONPOLICY_H
@@ -0,0 +1,203 @@
+#include "conversion.h"
+#include "docxconverter.h"
+#include "htmlimages.h"
+#include "imagestore.h"
+
+#include <QTextDocument>
+#include <QTextStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryFile>
+#include <QBuffer>
+#include <QPdfWriter>
+#include <QPageSize>
+#include <QPageLayout>
+#include <QMarginsF>
+#include <QHash>
+
+namespace {
+
+void setDocument(QTextDocument *doc, const QString &html,
+                 const QHash<QString, QByteArray> &images) {
+    doc->setHtml(html);
+    // Must happen AFTER setHtml() because setHtml() clears the document
+    for (auto it = images.constBegin(); it != images.constEnd(); ++it)
+        ImageStore::add(doc, it.key(), it.value());
+}
+
+void setHtmlDocument(QTextDocument *doc, const QString &html) {
+    int counter = 0;
+    QHash<QString, QByteArray> images;
+    const QString rewritten = HtmlImages::extractDataUris(html, counter, images);
+    setDocument(doc, rewritten, images);
+}
+
+bool loadDocx(QTextDocument *doc, const QString &filePath, QString *errorOut,
+              const std::atomic<bool> *cancel) {
+    return DocxConverter::importDocx(filePath, doc, errorOut, {}, cancel);
+}
+
+bool cancelled(const std::atomic<bool> *cancel, QString *errorOut) {
+    if (!cancel || !cancel->load(std::memory_order_relaxed)) return false;
+    if (errorOut) *errorOut = QStringLiteral("Cancelled");
+    return true;
+}
+
+void writePdf(const QTextDocument *doc, QIODevice *device) {
+    QPdfWriter writer(device);
+    writer.setCreator(QStringLiteral("MattWord"));
+    writer.setPageSize(QPageSize(QPageSize::Letter));
+    writer.setPageMargins(QMarginsF(72, 72, 72, 72), QPageLayout::Point);
+    doc->print(&writer);
+}
+
+} // anonymous namespace
+
+Conversion::Format Conversion::formatForPath(const QString &filePath) {
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    if (suffix == QLatin1String("docx")) return Format::Docx;
+    if (suffix == QLatin1String("html") || suffix == QLatin1String("htm"))
+        return Format::Html;
+    if (suffix == QLatin1String("pdf")) return Format::Pdf;
+    return Format::Unknown;
+}
+
+Conversion::Format Conversion::formatOfData(const QByteArray &data) {
+    return data.startsWith("PK\x03\x04") ? Format::Docx : Format::Html;
+}
+
+QString Conversion::formatName(Format format) {
+    switch (format) {
+    case Format::Html: return QStringLiteral("html");
+    case Format::Docx: return QStringLiteral("docx");
+    case Format::Pdf: return QStringLiteral("pdf");
+    case Format::Unknown: break;
+    }
+    return QString();
+}
+
+Conversion::Format Conversion::formatFromName(const QString &name) {
+    const QString n = name.toLower();
+    if (n == QLatin1String("docx")) return Format::Docx;
+    if (n == QLatin1String("html") || n == QLatin1String("htm"))
+        return Format::Html;
+    if (n == QLatin1String("pdf")) return Format::Pdf;
+    return Format::Unknown;
+}
+
+bool Conversion::load(QTextDocument *doc, const QString &filePath,
+                      QString *errorOut, const std::atomic<bool> *cancel) {
+    const Format format = formatForPath(filePath);
+    if (format == Format::Docx)
+        return loadDocx(doc, filePath, errorOut, cancel);
+    if (format == Format::Pdf) {
+        if (errorOut) *errorOut = QStringLiteral("PDF files can't be opened.");
+        return false;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (errorOut)
+            *errorOut = QStringLiteral("Cannot open file: ") + file.errorString();
+        return false;
+    }
+    QTextStream in(&file);
+    const QString html = in.readAll();
+    if (cancelled(cancel, errorOut)) return false;
+    setHtmlDocument(doc, html);
+    return true;
+}
+
+bool Conversion::loadData(QTextDocument *doc, const QByteArray &data,
+                          Format format, QString *errorOut,
+                          const std::atomic<bool> *cancel) {
+    if (cancelled(cancel, errorOut)) return false;
+    if (format == Format::Unknown) format = formatOfData(data);
+    if (format == Format::Pdf) {
+        if (errorOut) *errorOut = QStringLiteral("PDF files can't be opened.");
+        return false;
+    }
+    if (format == Format::Html) {
+        setHtmlDocument(doc, QString::fromUtf8(data));
+        return true;
+    }
+
+    // The .docx reader works from a file
+    QTemporaryFile tmp;
+    if (!tmp.open() || tmp.write(data) != data.size() || !tmp.flush()) {
+        if (errorOut)
+            *errorOut = QStringLiteral("Cannot write temporary file: ") + tmp.errorString();
+        return false;
+    }
+    tmp.close();
+    return loadDocx(doc, tmp.fileName(), errorOut, cancel);
+}
+
+bool Conversion::save(const QTextDocument *doc, const QString &filePath,
+                      QString *errorOut) {
+    return save(doc, filePath, formatForPath(filePath), errorOut);
+}
+
+bool Conversion::save(const QTextDocument *doc, const QString &filePath,
+                      Format format, QString *errorOut) {
+    if (format == Format::Docx)
+        return DocxConverter::exportDocx(doc, filePath, errorOut);
+
+    QFile file(filePath);
+    const QIODevice::OpenMode mode = format == Format::Pdf
+        ? QIODevice::WriteOnly : QIODevice::WriteOnly | QIODevice::Text;
+    if (!file.open(mode)) {
+        if (errorOut)
+            *errorOut = QStringLiteral("Cannot write file %1").arg(filePath);
+        return false;
+    }
+    if (format == Format::Pdf) {
+        writePdf(doc, &file);
+        return true;
+    }
+    QTextStream out(&file);
+    out << HtmlImages::embedDataUris(doc->toHtml(), doc);
+    out.flush();
+    if (out.status() != QTextStream::Ok) {
+        if (errorOut)
+            *errorOut = QStringLiteral("Cannot write file %1").arg(filePath);
+        return false;
+    }
+    return true;
+}
+
+bool Conversion::saveData(const QTextDocument *doc, Format format,
+                          QByteArray &dataOut, QString *errorOut) {
+    if (format == Format::Pdf) {
+        dataOut.clear();
+        QBuffer buffer(&dataOut);
+        buffer.open(QIODevice::WriteOnly);
+        writePdf(doc, &buffer);
+        return true;
+    }
+    if (format != Format::Docx) {
+        dataOut = HtmlImages::embedDataUris(doc->toHtml(), doc).toUtf8();
+        return true;
+    }
+
+    // The .docx writer works to a file
+    QTemporaryFile tmp;
+    if (!tmp.open()) {
+        if (errorOut)
+            *errorOut = QStringLiteral("Cannot create temporary file: ") + tmp.errorString();
+        return false;
+    }
+    const QString tmpPath = tmp.fileName();
+    tmp.close();
+    if (!DocxConverter::exportDocx(doc, tmpPath, errorOut))
+        return false;
+
+    QFile file(tmpPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorOut)
+            *errorOut = QStringLiteral("Cannot read temporary file: ") + file.errorString();
+        return false;
+    }
+    dataOut = file.readAll();
+    return true;
+}
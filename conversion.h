@@ -0,0 +1,57 @@
+#ifndef CONVERSION_H
+#define CONVERSION_H
+
+#include <QString>
+#include <QByteArray>
+
+#include <atomic>
+
+class QTextDocument;
+
+// Loading and saving whole documents in either of MattWord's formats,
+// without any widgets: the editor's Save goes through here, and so does
+// the headless mattword-convert tool. Everything works on a plain
+// QTextDocument, so separate documents can be converted on separate
+// threads at the same time.
+namespace Conversion {
+
+// Pdf is output only.
+enum class Format { Unknown, Html, Docx, Pdf };
+
+// From the file suffix (.html/.htm, .docx or .pdf).
+Format formatForPath(const QString &filePath);
+
+// From the content: a zip archive is taken to be .docx, anything else
+// as HTML.
+Format formatOfData(const QByteArray &data);
+
+// "html" / "docx" / "pdf", and back; Unknown if not recognised.
+QString formatName(Format format);
+Format formatFromName(const QString &name);
+
+// Replace the contents of `doc` with the document in `filePath` / `data`
+// (embedded images become document resources, see HtmlImages and
+// ImageStore). On failure returns false and sets *errorOut. Setting
+// `*cancel` from another thread stops a .docx import part way, as a
+// failure; HTML is only checked before it's parsed.
+bool load(QTextDocument *doc, const QString &filePath,
+          QString *errorOut = nullptr,
+          const std::atomic<bool> *cancel = nullptr);
+bool loadData(QTextDocument *doc, const QByteArray &data, Format format,
+              QString *errorOut = nullptr,
+              const std::atomic<bool> *cancel = nullptr);
+
+// Write `doc` to `filePath` / `dataOut`. PDF is laid out on Letter paper
+// with the editor's default one-inch margins. On failure returns false
+// and sets *errorOut.
+// save() without a format goes by the file suffix.
+bool save(const QTextDocument *doc, const QString &filePath,
+          QString *errorOut = nullptr);
+bool save(const QTextDocument *doc, const QString &filePath, Format format,
+          QString *errorOut = nullptr);
+bool saveData(const QTextDocument *doc, Format format, QByteArray &dataOut,
+              QString *errorOut = nullptr);
+
+} // namespace Conversion
+
+#endif // CONVERSION_H
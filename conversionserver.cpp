@@ -0,0 +1,271 @@
+#include "conversionserver.h"
+#include "conversion.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTextDocument>
+#include <QTimer>
+#include <QThread>
+#include <QRunnable>
+#include <QMetaObject>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+
+// Recent latencies kept for the percentiles
+constexpr int LATENCY_WINDOW = 1024;
+
+// Keep at most this much unread request data buffered per connection;
+// beyond it the client blocks on its socket until we catch up
+constexpr qint64 SOCKET_READ_BUFFER = 1024 * 1024;
+
+// How long listen() waits for an answer on an existing socket before
+// deciding it's stale
+constexpr int STALE_PROBE_MS = 1000;
+
+bool convert(quint8 op, const QByteArray &input, QByteArray &output,
+             QString *errorOut, const std::atomic<bool> *cancel) {
+    using Conversion::Format;
+    Format from, to;
+    switch (op) {
+    case ConversionServer::HtmlToDocx: from = Format::Html; to = Format::Docx; break;
+    case ConversionServer::DocxToHtml: from = Format::Docx; to = Format::Html; break;
+    default: from = Conversion::formatOfData(input); to = Format::Pdf; break;
+    }
+
+    QTextDocument doc;
+    return Conversion::loadData(&doc, input, from, errorOut, cancel) &&
+           !cancel->load(std::memory_order_relaxed) &&
+           Conversion::saveData(&doc, to, output, errorOut);
+}
+
+qint64 percentile(QVector<qint64> sorted, double p) {
+    if (sorted.isEmpty()) return 0;
+    const int i = qBound(0, int(p * (sorted.size() - 1) + 0.5), int(sorted.size()) - 1);
+    return sorted.at(i);
+}
+
+} // anonymous namespace
+
+ConversionServer::ConversionServer(const Options &options, QObject *parent)
+    : QObject(parent), opts(options), server(new QLocalServer(this)) {
+    if (opts.workers <= 0) opts.workers = QThread::idealThreadCount();
+    workers.setMaxThreadCount(opts.workers);
+    // Keep the threads warm between bursts
+    workers.setExpiryTimeout(-1);
+    latencies.reserve(LATENCY_WINDOW);
+    uptime.start();
+
+    connect(server, &QLocalServer::newConnection, this, &ConversionServer::onNewConnection);
+}
+
+ConversionServer::~ConversionServer() {
+    // Workers post their results back to this object
+    workers.clear();
+    workers.waitForDone();
+}
+
+bool ConversionServer::listen(const QString &name, QString *errorOut) {
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!server->listen(name) &&
+        server->serverError() == QAbstractSocket::AddressInUseError) {
+        // Left behind by a server that died, or still in use by a running
+        // one: only a socket nobody answers on is removed
+        QLocalSocket probe;
+        probe.connectToServer(name);
+        if (probe.waitForConnected(STALE_PROBE_MS)) {
+            probe.disconnectFromServer();
+            if (errorOut)
+                *errorOut = QStringLiteral("A server is already listening on %1")
+                                .arg(name);
+            return false;
+        }
+        QLocalServer::removeServer(name);
+        server->listen(name);
+    }
+    if (!server->isListening()) {
+        if (errorOut) *errorOut = server->errorString();
+        return false;
+    }
+    return true;
+}
+
+void ConversionServer::onNewConnection() {
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        socket->setReadBufferSize(SOCKET_READ_BUFFER);
+
+        Connection &c = connections[socket];
+        c.timeout = new QTimer(socket);
+        c.timeout->setSingleShot(true);
+        connect(c.timeout, &QTimer::timeout, this, [this, socket] { jobTimedOut(socket); });
+
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket] { processInput(socket); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket] {
+            const Connection c = connections.take(socket);
+            // A worker may still be on it: stop it, and its result will
+            // find no taker
+            if (c.pendingJob) cancelJob(c.pendingJob);
+            socket->deleteLater();
+        });
+    }
+}
+
+void ConversionServer::processInput(QLocalSocket *socket) {
+    auto it = connections.find(socket);
+    if (it == connections.end()) return;
+    Connection &c = it.value();
+    // One request at a time: leave the rest unread (backpressure)
+    if (c.pendingJob) return;
+
+    c.buffer += socket->readAll();
+    if (c.buffer.size() < 4) return;
+
+    const quint32 length = qFromBigEndian<quint32>(c.buffer.constData());
+    if (length < 1 || qint64(length) > opts.maxRequestBytes + 1) {
+        reply(socket, Error, QByteArrayLiteral("Bad request length"));
+        socket->disconnectFromServer();
+        return;
+    }
+    if (c.buffer.size() < 4 + qint64(length)) return;
+
+    const quint8 op = quint8(c.buffer.at(4));
+    const QByteArray payload = c.buffer.mid(5, length - 1);
+    c.buffer.remove(0, 4 + length);
+    dispatch(socket, op, payload);
+}
+
+void ConversionServer::dispatch(QLocalSocket *socket, quint8 op, const QByteArray &payload) {
+    if (op == Stats) {
+        reply(socket, Ok, statsJson());
+        QMetaObject::invokeMethod(this, [this, socket] { processInput(socket); },
+                                  Qt::QueuedConnection);
+        return;
+    }
+    if (op != HtmlToDocx && op != DocxToHtml && op != ToPdf) {
+        reply(socket, Error, QByteArrayLiteral("Unknown operation"));
+        QMetaObject::invokeMethod(this, [this, socket] { processInput(socket); },
+                                  Qt::QueuedConnection);
+        return;
+    }
+    if (inFlight >= opts.workers + opts.maxQueue) {
+        ++rejected;
+        reply(socket, Busy, QByteArrayLiteral("Server busy, try again later"));
+        QMetaObject::invokeMethod(this, [this, socket] { processInput(socket); },
+                                  Qt::QueuedConnection);
+        return;
+    }
+
+    const quint64 id = nextJob++;
+    Connection &c = connections[socket];
+    c.pendingJob = id;
+    c.started.start();
+    if (opts.timeoutMs > 0) c.timeout->start(opts.timeoutMs);
+    jobs.insert(id, socket);
+    const auto cancel = QSharedPointer<std::atomic<bool>>::create(false);
+    cancels.insert(id, cancel);
+    ++inFlight;
+    ++accepted;
+    bytesIn += payload.size();
+
+    workers.start(QRunnable::create([this, id, op, payload, cancel] {
+        QByteArray output;
+        QString error;
+        // A job cancelled while still queued gives its thread straight back
+        const bool ok = !cancel->load(std::memory_order_relaxed) &&
+                        convert(op, payload, output, &error, cancel.data());
+        QMetaObject::invokeMethod(this, [this, id, ok, output, error] {
+            jobDone(id, ok, output, error);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void ConversionServer::jobDone(quint64 id, bool ok, const QByteArray &output,
+                               const QString &error) {
+    --inFlight;
+    cancels.remove(id);
+    QLocalSocket *socket = jobs.take(id);
+    if (!socket) return; // timed out or disconnected
+
+    Connection &c = connections[socket];
+    c.timeout->stop();
+    c.pendingJob = 0;
+    recordLatency(c.started.elapsed());
+    if (ok) {
+        ++completed;
+        bytesOut += output.size();
+        reply(socket, Ok, output);
+    } else {
+        ++failed;
+        reply(socket, Error, error.toUtf8());
+    }
+    processInput(socket);
+}
+
+void ConversionServer::jobTimedOut(QLocalSocket *socket) {
+    auto it = connections.find(socket);
+    if (it == connections.end() || !it->pendingJob) return;
+    cancelJob(it->pendingJob);
+    it->pendingJob = 0;
+    ++timedOut;
+    recordLatency(it->started.elapsed());
+    reply(socket, TimedOut, QByteArrayLiteral("Conversion timed out"));
+    processInput(socket);
+}
+
+void ConversionServer::cancelJob(quint64 id) {
+    jobs.remove(id);
+    // The flag itself stays until jobDone(), which the worker still posts
+    if (const auto cancel = cancels.value(id))
+        cancel->store(true, std::memory_order_relaxed);
+}
+
+void ConversionServer::reply(QLocalSocket *socket, Status status, const QByteArray &payload) {
+    char header[5];
+    qToBigEndian<quint32>(quint32(payload.size() + 1), header);
+    header[4] = char(status);
+    socket->write(header, sizeof header);
+    socket->write(payload);
+}
+
+void ConversionServer::recordLatency(qint64 ms) {
+    if (latencies.size() < LATENCY_WINDOW) {
+        latencies.append(ms);
+    } else {
+        latencies[latencyNext] = ms;
+        latencyNext = (latencyNext + 1) % LATENCY_WINDOW;
+    }
+}
+
+QByteArray ConversionServer::statsJson() const {
+    QVector<qint64> sorted = latencies;
+    std::sort(sorted.begin(), sorted.end());
+    const double seconds = qMax<qint64>(1, uptime.elapsed()) / 1000.0;
+
+    QJsonObject latency;
+    latency["p50"] = percentile(sorted, 0.50);
+    latency["p90"] = percentile(sorted, 0.90);
+    latency["p99"] = percentile(sorted, 0.99);
+    latency["max"] = sorted.isEmpty() ? 0 : sorted.last();
+    latency["samples"] = int(sorted.size());
+
+    QJsonObject o;
+    o["workers"] = opts.workers;
+    o["inFlight"] = inFlight;
+    o["queueDepth"] = qMax(0, inFlight - opts.workers);
+    o["maxQueue"] = opts.maxQueue;
+    o["connections"] = int(connections.size());
+    o["accepted"] = double(accepted);
+    o["completed"] = double(completed);
+    o["failed"] = double(failed);
+    o["rejected"] = double(rejected);
+    o["timedOut"] = double(timedOut);
+    o["bytesIn"] = double(bytesIn);
+    o["bytesOut"] = double(bytesOut);
+    o["uptimeSeconds"] = seconds;
+    o["completedPerSecond"] = completed / seconds;
+    o["latencyMs"] = latency;
+    return QJsonDocument(o).toJson(QJsonDocument::Compact);
+}
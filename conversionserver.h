@@ -0,0 +1,104 @@
+#ifndef CONVERSIONSERVER_H
+#define CONVERSIONSERVER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+
+#include <atomic>
+
+class QLocalServer;
+class QLocalSocket;
+class QTimer;
+
+// Long-running conversion service on a local (Unix domain) socket, so a
+// document pipeline pays Qt's start-up cost once instead of per file.
+//
+// Wire format, both directions: a 4-byte big-endian length, then that many
+// bytes of frame. A request frame is a 1-byte Op followed by the input
+// document; a reply frame is a 1-byte Status followed by the output
+// document (Ok), a UTF-8 message (Error, Busy, TimedOut) or, for Stats, a
+// JSON object. Each connection has one request in flight at a time; send
+// the next after reading the reply, or open more connections.
+//
+// Conversions run on a pool of worker threads, each with its own
+// QTextDocument. When every worker is busy and `maxQueue` requests are
+// already waiting, new ones are answered Busy straight away rather than
+// queued without bound. A request not finished within `timeoutMs` is
+// answered TimedOut and its worker is told to stop: a .docx import gives
+// up part way, and a job still queued never starts. (Parsing HTML and
+// writing the output can't be interrupted; those finish first.) The same
+// happens when the client disconnects.
+class ConversionServer : public QObject {
+    Q_OBJECT
+public:
+    enum Op : quint8 {
+        HtmlToDocx = 1,
+        DocxToHtml = 2,
+        ToPdf = 3,        // input may be HTML or .docx
+        Stats = 4,        // no payload
+    };
+    enum Status : quint8 { Ok = 0, Error = 1, Busy = 2, TimedOut = 3 };
+
+    struct Options {
+        int workers = 0;                           // 0 = one per core
+        int maxQueue = 64;                         // waiting beyond busy workers
+        int timeoutMs = 30000;                     // 0 = no limit
+        qint64 maxRequestBytes = 256 * 1024 * 1024;
+    };
+
+    explicit ConversionServer(const Options &options, QObject *parent = nullptr);
+    ~ConversionServer();
+
+    // Start listening on `name` (a socket path, or a name Qt places in the
+    // temp directory). A stale socket left by a crashed server is removed;
+    // if another server still answers on it, this fails instead.
+    bool listen(const QString &name, QString *errorOut = nullptr);
+
+private:
+    struct Connection {
+        QByteArray buffer;
+        quint64 pendingJob = 0;   // 0 = idle
+        QElapsedTimer started;
+        QTimer *timeout = nullptr;
+    };
+
+    void onNewConnection();
+    void processInput(QLocalSocket *socket);
+    void dispatch(QLocalSocket *socket, quint8 op, const QByteArray &payload);
+    void jobDone(quint64 id, bool ok, const QByteArray &output, const QString &error);
+    void jobTimedOut(QLocalSocket *socket);
+    // Drop job `id`'s result and tell its worker to stop
+    void cancelJob(quint64 id);
+    void reply(QLocalSocket *socket, Status status, const QByteArray &payload);
+    void recordLatency(qint64 ms);
+    QByteArray statsJson() const;
+
+    Options opts;
+    QLocalServer *server;
+    QThreadPool workers;
+    QHash<QLocalSocket *, Connection> connections;
+    QHash<quint64, QLocalSocket *> jobs;   // in flight and still wanted
+    QHash<quint64, QSharedPointer<std::atomic<bool>>> cancels; // every job in flight
+    quint64 nextJob = 1;
+
+    // Counters
+    int inFlight = 0;          // accepted and not yet finished by a worker
+    quint64 accepted = 0;
+    quint64 completed = 0;
+    quint64 failed = 0;
+    quint64 rejected = 0;
+    quint64 timedOut = 0;
+    quint64 bytesIn = 0;
+    quint64 bytesOut = 0;
+    QVector<qint64> latencies; // ring of recent request latencies, ms
+    int latencyNext = 0;
+    QElapsedTimer uptime;
+};
+
+#endif // CONVERSIONSERVER_H
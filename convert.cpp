@@ -0,0 +1,209 @@
+// convert.cpp — mattword-convert: headless HTML <-> .docx conversion
+// using the same import/export code as the editor.
+#include "conversion.h"
+#include "compressionpolicy.h"
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QTextDocument>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QThread>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <cstdio>
+
+namespace {
+
+struct Job {
+    QString input;        // "-" = stdin
+    QString output;       // "-" = stdout
+    Conversion::Format to = Conversion::Format::Unknown; // Unknown = opposite of input
+    bool ok = false;
+    QString error;
+};
+
+Conversion::Format opposite(Conversion::Format from) {
+    return from == Conversion::Format::Docx ? Conversion::Format::Html
+                                            : Conversion::Format::Docx;
+}
+
+void run(Job &job) {
+    // One document per job, created and destroyed on the worker thread
+    QTextDocument doc;
+
+    Conversion::Format from;
+    if (job.input == QLatin1String("-")) {
+        QFile in;
+        if (!in.open(stdin, QIODevice::ReadOnly)) {
+            job.error = QStringLiteral("Cannot read standard input");
+            return;
+        }
+        const QByteArray data = in.readAll();
+        from = Conversion::formatOfData(data);
+        if (!Conversion::loadData(&doc, data, from, &job.error)) return;
+    } else {
+        from = Conversion::formatForPath(job.input);
+        if (!Conversion::load(&doc, job.input, &job.error)) return;
+    }
+
+    const Conversion::Format to =
+        job.to == Conversion::Format::Unknown ? opposite(from) : job.to;
+
+    if (job.output == QLatin1String("-")) {
+        QByteArray data;
+        if (!Conversion::saveData(&doc, to, data, &job.error)) return;
+        QFile out;
+        if (!out.open(stdout, QIODevice::WriteOnly) ||
+            out.write(data) != data.size()) {
+            job.error = QStringLiteral("Cannot write standard output");
+            return;
+        }
+        out.flush();
+    } else {
+        if (!Conversion::save(&doc, job.output, to, &job.error)) return;
+    }
+    job.ok = true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[]) {
+    // Fonts and images need a QGuiApplication, but not a display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("MattWord");
+    QCoreApplication::setApplicationName("mattword-convert");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Convert documents between HTML and .docx without a display.\n"
+        "Each input is converted to the other format next to itself unless\n"
+        "--to, --output or --output-dir say otherwise. Use - for stdin.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("inputs", "Files to convert (.html, .htm, .docx, or -).",
+                                 "<input>...");
+    const QCommandLineOption toOpt(
+        QStringList() << "t" << "to", "Output format: html, docx or pdf.", "format");
+    const QCommandLineOption outputOpt(
+        QStringList() << "o" << "output",
+        "Output file (single input only; - for stdout).", "file");
+    const QCommandLineOption dirOpt(
+        QStringList() << "d" << "output-dir", "Directory for output files.", "dir");
+    const QCommandLineOption jobsOpt(
+        QStringList() << "j" << "jobs",
+        "Convert up to N files at once (default: one per core).", "N");
+    const QCommandLineOption fastOpt(
+        "fast", "Compress .docx output for speed rather than size.");
+    const QCommandLineOption verboseOpt(
+        QStringList() << "v" << "verbose", "Print each file as it's converted.");
+    parser.addOptions({toOpt, outputOpt, dirOpt, jobsOpt, fastOpt, verboseOpt});
+    parser.process(app);
+
+    const QStringList inputs = parser.positionalArguments();
+    if (inputs.isEmpty()) parser.showHelp(2);
+
+    auto fail = [](const QString &message) {
+        std::fprintf(stderr, "mattword-convert: %s\n", qPrintable(message));
+        return 2;
+    };
+
+    Conversion::Format to = Conversion::Format::Unknown;
+    if (parser.isSet(toOpt)) {
+        to = Conversion::formatFromName(parser.value(toOpt));
+        if (to == Conversion::Format::Unknown)
+            return fail(QStringLiteral("unknown format \"%1\"").arg(parser.value(toOpt)));
+    }
+    if (parser.isSet(outputOpt) && inputs.size() != 1)
+        return fail(QStringLiteral("--output needs exactly one input"));
+    if (inputs.count(QStringLiteral("-")) > 1)
+        return fail(QStringLiteral("standard input can only be read once"));
+
+    if (parser.isSet(fastOpt))
+        CompressionPolicy::setMode(CompressionPolicy::Mode::FastSave);
+
+    int jobCount = QThread::idealThreadCount();
+    if (parser.isSet(jobsOpt)) {
+        bool ok = false;
+        jobCount = parser.value(jobsOpt).toInt(&ok);
+        if (!ok || jobCount < 1)
+            return fail(QStringLiteral("--jobs needs a positive number"));
+    }
+
+    const QString outDir = parser.value(dirOpt);
+    if (!outDir.isEmpty() && !QDir().mkpath(outDir))
+        return fail(QStringLiteral("cannot create %1").arg(outDir));
+
+    // Every input, so no job writes over a file another job reads
+    QSet<QString> inputPaths;
+    for (const QString &input : inputs)
+        if (input != QLatin1String("-"))
+            inputPaths.insert(QFileInfo(input).absoluteFilePath());
+
+    QList<Job> jobs;
+    QHash<QString, QString> outputPaths; // absolute output -> its input
+    for (const QString &input : inputs) {
+        Job job;
+        job.input = input;
+        job.to = to;
+
+        if (parser.isSet(outputOpt)) {
+            job.output = parser.value(outputOpt);
+            if (job.to == Conversion::Format::Unknown && job.output != QLatin1String("-"))
+                job.to = Conversion::formatForPath(job.output);
+        } else if (input == QLatin1String("-")) {
+            job.output = QStringLiteral("-");
+        } else {
+            const QFileInfo fi(input);
+            const Conversion::Format target = job.to == Conversion::Format::Unknown
+                ? opposite(Conversion::formatForPath(input)) : job.to;
+            job.to = target;
+            const QString dir = outDir.isEmpty() ? fi.path() : outDir;
+            job.output = QDir(dir).filePath(fi.completeBaseName() + "." +
+                                            Conversion::formatName(target));
+        }
+
+        if (job.output != QLatin1String("-")) {
+            // Checked before any job starts: jobs run at once, so two
+            // writing one file would silently lose a document
+            const QString outPath = QFileInfo(job.output).absoluteFilePath();
+            if (outPath == QFileInfo(input).absoluteFilePath())
+                return fail(QStringLiteral("%1 would overwrite itself").arg(input));
+            if (outputPaths.contains(outPath))
+                return fail(QStringLiteral("%1 and %2 would both be written to %3")
+                                .arg(outputPaths.value(outPath), input, job.output));
+            if (inputPaths.contains(outPath))
+                return fail(QStringLiteral("%1 would overwrite the input %2")
+                                .arg(input, job.output));
+            outputPaths.insert(outPath, input);
+        }
+        jobs.append(job);
+    }
+
+    if (jobCount == 1 || jobs.size() == 1) {
+        for (Job &job : jobs) run(job);
+    } else {
+        QThreadPool pool;
+        pool.setMaxThreadCount(jobCount);
+        for (Job &job : jobs)
+            pool.start(QRunnable::create([&job] { run(job); }));
+        pool.waitForDone();
+    }
+
+    // Report in input order, whatever order the workers finished in
+    int failed = 0;
+    for (const Job &job : jobs) {
+        if (!job.ok) {
+            ++failed;
+            std::fprintf(stderr, "%s: %s\n", qPrintable(job.input), qPrintable(job.error));
+        } else if (parser.isSet(verboseOpt)) {
+            std::fprintf(stderr, "%s -> %s\n", qPrintable(job.input), qPrintable(job.output));
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,50 @@
+#include "deflatebackend.h"
+
+#include "miniz.h"
+
+namespace {
+
+// tdefl_put_buf_func_ptr
+mz_bool appendOutput(const void *buf, int len, void *user) {
+    static_cast<QByteArray *>(user)->append(static_cast<const char *>(buf), len);
+    return MZ_TRUE;
+}
+
+class MinizBackend : public ZipDeflate::Backend {
+public:
+    const char *name() const override { return "miniz"; }
+    bool canFlush() const override { return true; }
+
+    bool deflatePiece(const char *in, qsizetype size, QByteArray &out, int level,
+                      bool last) const override {
+        // Negative window bits: a raw stream, no zlib header
+        const int flags = int(tdefl_create_comp_flags_from_zip_params(
+            level, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY));
+        tdefl_compressor *comp = tdefl_compressor_alloc();
+        if (!comp) return false;
+        out.reserve(out.size() + size / 2 + 64);
+        bool ok = tdefl_init(comp, &appendOutput, &out, flags) == TDEFL_STATUS_OKAY;
+        if (ok) {
+            const tdefl_status status = tdefl_compress_buffer(
+                comp, in, size_t(size), last ? TDEFL_FINISH : TDEFL_SYNC_FLUSH);
+            ok = status == (last ? TDEFL_STATUS_DONE : TDEFL_STATUS_OKAY);
+        }
+        tdefl_compressor_free(comp);
+        return ok;
+    }
+};
+
+} // anonymous namespace
+
+const ZipDeflate::Backend &ZipDeflate::backend() {
+#ifdef MATTWORD_WITH_LIBDEFLATE
+    return libdeflateBackend();
+#else
+    return minizBackend();
+#endif
+}
+
+const ZipDeflate::Backend &ZipDeflate::minizBackend() {
+    static const MinizBackend miniz;
+    return miniz;
+}
@@ -0,0 +1,39 @@
+#ifndef DEFLATEBACKEND_H
+#define DEFLATEBACKEND_H
+
+#include <QByteArray>
+
+// The library that does ZipDeflate's compressing. Bundled miniz is always
+// there; a build configured with MATTWORD_SYSTEM_DEFLATE uses libdeflate
+// instead, if CMake found it. Every backend writes a plain raw deflate
+// stream, so the package miniz assembles around it is the same.
+namespace ZipDeflate {
+
+class Backend {
+public:
+    virtual ~Backend() = default;
+
+    virtual const char *name() const = 0;
+
+    // Whether a piece can end in a sync flush, so separately compressed
+    // pieces concatenate into one stream. One that can't only ever gets
+    // the last piece of an entry; miniz compresses the ones before it.
+    virtual bool canFlush() const = 0;
+
+    // Append the raw deflate of `size` bytes at `in` to `out`, at `level`
+    // (1-9). The piece is sync-flushed, or finishes the stream if `last`.
+    // Safe to call from several threads at once.
+    virtual bool deflatePiece(const char *in, qsizetype size, QByteArray &out,
+                              int level, bool last) const = 0;
+};
+
+// The backend export uses: libdeflate when built in, miniz otherwise
+const Backend &backend();
+
+const Backend &minizBackend();
+// Defined in its own file, which is only built with libdeflate
+const Backend &libdeflateBackend();
+
+} // namespace ZipDeflate
+
+#endif // DEFLATEBACKEND_H
@@ -4,17 +4,34 @@
 #include <QTextBlock>
 #include <QTextFragment>
 #include <QTextImageFormat>
+#include <QTextCursor>
+#include <QTextBlockFormat>
 #include <QXmlStreamReader>
 #include <QImage>
+#include <QImageReader>
+#include <QtEndian>
 #include <QBuffer>
 #include <QFile>
+#include <QSaveFile>
 #include <QFileInfo>
 #include <QVariant>
 #include <QUrl>
 #include <QDebug>
 #include <QRegularExpression>
+#include <QElapsedTimer>
+#include <limits>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
 
+#include "imageingest.h"
+#include "imagestore.h"
+#include "compressionpolicy.h"
 #include "miniz.h"
+#include "xmlwriter.h"
+#include "zipdeflate.h"
 
 namespace {
 
@@ -32,13 +49,20 @@ namespace {
 constexpr double DOTS_PER_METER = 3780.0;    // what Qt writes as pHYs
 constexpr double EMU_PER_METER  = 36000000.0; // exact: 914400 EMU/in ÷ 0.0254
 
-inline qint64 pxToEmu(int px) {
-    return qRound64(px * EMU_PER_METER / DOTS_PER_METER);
+inline qint64 pxToEmu(int px, double dotsPerMeter = DOTS_PER_METER) {
+    return qRound64(px * EMU_PER_METER / dotsPerMeter);
 }
 inline int emuToPx(qint64 emu) {
     return static_cast<int>(qRound(emu * DOTS_PER_METER / EMU_PER_METER));
 }
 
+// Image format properties recording the wp:extent an imported picture
+// came with, so an untouched picture is exported as it was imported
+enum : int {
+    DocxExtentCx = QTextFormat::UserProperty + 0x100,
+    DocxExtentCy,
+};
+
 QString xmlEscape(const QString &s) {
     QString r = s;
     r.replace('&', "&amp;");
@@ -48,6 +72,51 @@ QString xmlEscape(const QString &s) {
     return r;
 }
 
+// Physical density an encoded image declares, in dots per meter: the PNG
+// pHYs chunk or the JPEG JFIF header. GIF has no density field and is
+// taken at the nominal 96 dpi consumers assume for it. Returns 0 when
+// nothing usable is declared. Only header bytes are looked at.
+double declaredDotsPerMeter(const QByteArray &bytes,
+                            const QByteArray &format) {
+    const auto *d = reinterpret_cast<const uchar *>(bytes.constData());
+    const qint64 size = bytes.size();
+
+    if (format == "png") {
+        qint64 pos = 8; // past the signature
+        while (pos + 8 <= size) {
+            const quint32 len = qFromBigEndian<quint32>(d + pos);
+            const char *type = bytes.constData() + pos + 4;
+            if (memcmp(type, "IDAT", 4) == 0) break; // pHYs must precede
+            if (memcmp(type, "pHYs", 4) == 0) {
+                if (len < 9 || pos + 8 + 9 > size) return 0;
+                const quint32 x = qFromBigEndian<quint32>(d + pos + 8);
+                const quint32 y = qFromBigEndian<quint32>(d + pos + 12);
+                const bool perMeter = d[pos + 16] == 1;
+                return (perMeter && x == y) ? double(x) : 0;
+            }
+            pos += 12 + qint64(len);
+        }
+        return 0;
+    }
+
+    if (format == "jpeg") {
+        // SOI, then an APP0 "JFIF\0" segment: units, Xdensity, Ydensity
+        if (size < 18 || d[0] != 0xFF || d[1] != 0xD8 || d[2] != 0xFF ||
+            d[3] != 0xE0 || memcmp(d + 6, "JFIF", 5) != 0)
+            return 0;
+        const int units = d[13];
+        const quint16 x = qFromBigEndian<quint16>(d + 14);
+        const quint16 y = qFromBigEndian<quint16>(d + 16);
+        if (x == 0 || x != y) return 0;
+        if (units == 1) return x / 0.0254; // dots per inch
+        if (units == 2) return x * 100.0;  // dots per cm
+        return 0;
+    }
+
+    if (format == "gif") return 96 / 0.0254;
+    return 0;
+}
+
 // ─── Static docx parts ─────────────────────────────────────────────────────
 
 QByteArray contentTypesXml() {
@@ -59,6 +128,7 @@ QByteArray contentTypesXml() {
         "<Default Extension=\"png\" ContentType=\"image/png\"/>"
         "<Default Extension=\"jpeg\" ContentType=\"image/jpeg\"/>"
         "<Default Extension=\"jpg\" ContentType=\"image/jpeg\"/>"
+        "<Default Extension=\"gif\" ContentType=\"image/gif\"/>"
         "<Override PartName=\"/word/document.xml\" "
         "ContentType=\"application/vnd.openxmlformats-officedocument.wordprocessingml.document.main+xml\"/>"
         "<Override PartName=\"/word/settings.xml\" "
@@ -93,199 +163,641 @@ QByteArray settingsXml() {
 
 // ─── Zip helpers (miniz) ───────────────────────────────────────────────────
 
-bool zipAdd(mz_zip_archive *zip, const char *name, const QByteArray &data) {
-    return mz_zip_writer_add_mem(zip, name, data.constData(),
-                                 static_cast<size_t>(data.size()),
-                                 MZ_DEFAULT_COMPRESSION) != MZ_FALSE;
+// Compressed by ZipDeflate's backend, like document.xml, rather than by
+// miniz's writer
+bool zipAdd(mz_zip_archive *zip, const char *name, const QByteArray &data,
+            CompressionPolicy::Mode mode = CompressionPolicy::mode()) {
+    return ZipDeflate::addToZip(
+        zip, name,
+        ZipDeflate::compress(data, CompressionPolicy::levelFor(data, false, mode)));
 }
 
+// mz_file_write_func over a QSaveFile
+size_t writeToFile(void *opaque, mz_uint64 offset, const void *data,
+                   size_t n) {
+    auto *file = static_cast<QSaveFile *>(opaque);
+    if (file->pos() != qint64(offset) && !file->seek(qint64(offset)))
+        return 0;
+    const qint64 written =
+        file->write(static_cast<const char *>(data), qint64(n));
+    return written < 0 ? 0 : size_t(written);
+}
+
+// Extracted straight into the QByteArray, sized from the central directory
 QByteArray zipRead(mz_zip_archive *zip, const QString &name, bool *found) {
     if (found) *found = false;
     int idx = mz_zip_reader_locate_file(zip, name.toUtf8().constData(),
                                         nullptr, 0);
     if (idx < 0) return {};
-    size_t size = 0;
-    void *p = mz_zip_reader_extract_to_heap(zip, static_cast<mz_uint>(idx),
-                                            &size, 0);
-    if (!p) return {};
-    QByteArray out(static_cast<const char *>(p), static_cast<int>(size));
-    mz_free(p);
+    mz_zip_archive_file_stat st;
+    if (!mz_zip_reader_file_stat(zip, static_cast<mz_uint>(idx), &st) ||
+        st.m_uncomp_size > quint64(std::numeric_limits<int>::max()))
+        return {};
+    QByteArray out(static_cast<int>(st.m_uncomp_size), Qt::Uninitialized);
+    if (!mz_zip_reader_extract_to_mem(zip, static_cast<mz_uint>(idx),
+                                      out.data(), size_t(out.size()), 0))
+        return {};
     if (found) *found = true;
     return out;
 }
 
-} // anonymous namespace
+// One zip entry read a piece at a time through miniz's iterative
+// extractor, so the whole inflated entry is never held in memory (nor,
+// from a file-backed archive, the whole compressed one)
+class ZipEntryReader {
+public:
+    static constexpr int CHUNK_BYTES = 64 * 1024;
 
-// ═══════════════════════════════════════════════════════════════════════════
-// Export
-// ═══════════════════════════════════════════════════════════════════════════
+    ZipEntryReader(mz_zip_archive *zip, mz_uint index)
+        : state(mz_zip_reader_extract_iter_new(zip, index, 0)),
+          total(state ? qint64(state->file_stat.m_uncomp_size) : 0) {}
+    ~ZipEntryReader() { finish(); }
 
-bool DocxConverter::exportDocx(const QTextDocument *doc,
-                               const QString &filePath, QString *errorOut) {
-    if (!doc) {
-        if (errorOut) *errorOut = QStringLiteral("No document to export.");
-        return false;
+    bool isOpen() const { return state != nullptr; }
+
+    // The next piece; empty at the end of the entry or on an error
+    QByteArray next() {
+        if (!state) return {};
+        QByteArray piece(CHUNK_BYTES, Qt::Uninitialized);
+        const size_t n = mz_zip_reader_extract_iter_read(
+            state, piece.data(), size_t(piece.size()));
+        piece.truncate(int(n));
+        inflated += qint64(n);
+        return piece;
     }
 
-    // Collected while walking the document; written into the zip afterwards
-    struct MediaEntry {
-        QString relId;       // "rId1", ...
-        QString mediaName;   // "media/image1.png"
-        QByteArray bytes;    // encoded image data
-    };
-    QList<MediaEntry> media;
-    int nextRel = 1;
+    // Bytes handed out so far, and the entry's full (inflated) size
+    qint64 bytesRead() const { return inflated; }
+    qint64 size() const { return total; }
+
+    // Close the entry without reading the rest
+    void abandon() {
+        if (state) mz_zip_reader_extract_iter_free(state);
+        state = nullptr;
+    }
+
+    // Read whatever is left and close the entry. False if it was damaged
+    // (bad deflate data, wrong size or CRC).
+    bool finish() {
+        if (!state) return ok;
+        while (!next().isEmpty()) {}
+        ok = mz_zip_reader_extract_iter_free(state) != MZ_FALSE;
+        state = nullptr;
+        return ok;
+    }
+
+private:
+    mz_zip_reader_extract_iter_state *state;
+    qint64 total;
+    qint64 inflated = 0;
+    bool ok = false;
+};
+
+// ─── Image preparation ─────────────────────────────────────────────────────
+
+// An inline picture as it goes into the package
+struct PreparedImage {
+    QByteArray bytes;    // encoded image data; empty = left out
+    ZipDeflate::Compressed packed; // the same, as it goes into the zip
+    QByteArray format;   // "png", "jpeg" or "gif"
+    qint64 cx = 0;       // declared extent, EMU
+    qint64 cy = 0;
+    int previous = -1;   // the same picture in the file being replaced
+    QString previousName; //   and its "media/..." name there
+};
+
+// What preparing a picture needs from the document, gathered up front so
+// the work itself doesn't touch the QTextDocument
+struct ImageSource {
+    QString name;
+    QByteArray bytes;    // ImageStore::bytes()
+    qreal width = 0;     // from the QTextImageFormat; 0 = natural size
+    qreal height = 0;
+    qint64 cx = 0;       // the extent it was imported with; 0 = none
+    qint64 cy = 0;
+};
+
+// Decide the picture's displayed size, bring its bytes to match and
+// pack them for the zip. Only depends on `source`, so it is safe to run on any
+// thread.
+PreparedImage prepareImage(const ImageSource &source) {
+    // Header-only probe; pixels are only decoded if they
+    // have to be resampled
+    QByteArray bytes = source.bytes;
+    QBuffer probeBuf;
+    probeBuf.setData(bytes);
+    probeBuf.open(QIODevice::ReadOnly);
+    QImageReader probe(&probeBuf);
+    const QSize stored = probe.size();
+    QByteArray format = probe.format().toLower();
+    const bool upright = !probe.transformation();
+    if (bytes.isEmpty() || !stored.isValid()) {
+        qDebug() << "exportDocx: skipping unresolvable image"
+                 << source.name;
+        return {};
+    }
+    const QSize intrinsic =
+        probe.transformation().testFlag(
+            QImageIOHandler::TransformationRotate90)
+            ? stored.transposed()
+            : stored;
+
+    // A picture imported from a .docx and shown at the size it came with
+    // goes back exactly as it was, bytes and extent: nothing is decoded,
+    // and a save over the same file can copy it from there
+    if (source.cx > 0 && source.cy > 0 &&
+        (format == "png" || format == "jpeg" || format == "gif") &&
+        qRound(source.width) == emuToPx(source.cx) &&
+        qRound(source.height) == emuToPx(source.cy)) {
+        PreparedImage prepared;
+        prepared.bytes = bytes;
+        prepared.packed = ZipDeflate::compress(
+            bytes, CompressionPolicy::levelFor(bytes, true));
+        prepared.format = format;
+        prepared.cx = source.cx;
+        prepared.cy = source.cy;
+        return prepared;
+    }
+
+    // Displayed size: honour the format's width; keep aspect.
+    // Sizes are forced to whole pixels and the bitmap is
+    // resampled to exactly the displayed size, so declared
+    // extent == intrinsic size == natural size and consumers
+    // can blit 1:1 (avoids seam artifacts in LO's scaler).
+    const int wPx = source.width > 0
+                        ? qRound(source.width)
+                        : intrinsic.width();
+    const int hPx = source.height > 0
+                        ? qRound(source.height)
+                        : (intrinsic.width() > 0
+                               ? qRound(qreal(wPx) *
+                                        intrinsic.height() /
+                                        intrinsic.width())
+                               : wPx);
+
+    // The stored bytes go into the package untouched when
+    // they're already exactly that size, in a container Word
+    // reads, and declare ~96 dpi (so their natural size is
+    // the extent we declare). Otherwise resample and encode:
+    // photos stay JPEG, everything else becomes PNG, both
+    // with a deterministic ~96 dpi — canvas/pasted images
+    // can otherwise carry screen DPI, which makes Writer
+    // rescale.
+    double dpm = declaredDotsPerMeter(bytes, format);
+    const bool passthrough =
+        (format == "png" || format == "jpeg" ||
+         format == "gif") &&
+        upright && stored == QSize(wPx, hPx) &&
+        qAbs(dpm - DOTS_PER_METER) < 1.0;
+    if (!passthrough) {
+        QImage img = ImageIngest::decodeData(bytes, wPx);
+        if (img.isNull()) {
+            qDebug() << "exportDocx: skipping unreadable image"
+                     << source.name;
+            return {};
+        }
+        if (img.width() != wPx || img.height() != hPx) {
+            img = img.scaled(wPx, hPx, Qt::IgnoreAspectRatio,
+                             Qt::SmoothTransformation);
+        }
+        format = format == "jpeg" ? QByteArray("jpeg")
+                                  : QByteArray("png");
+        bytes = ImageIngest::encode(img, format);
+        dpm = declaredDotsPerMeter(bytes, format);
+        if (dpm <= 0) dpm = DOTS_PER_METER;
+    }
+
+    // Extents on the image's own density basis: 3780 dpm for
+    // PNG, exactly 96 dpi (9525 EMU/px) for JPEG and GIF
+    const qint64 cx = pxToEmu(wPx, dpm);
+    const qint64 cy = pxToEmu(hPx, dpm);
 
-    QString body;
+    PreparedImage prepared;
+    prepared.bytes = bytes;
+    // Always a PNG, JPEG or GIF by now: stored, see CompressionPolicy
+    prepared.packed = ZipDeflate::compress(
+        bytes, CompressionPolicy::levelFor(bytes, true));
+    prepared.format = format;
+    prepared.cx = cx;
+    prepared.cy = cy;
+    return prepared;
+}
 
+// Prepare every inline picture in document order. Resampling, re-encoding
+// and compressing dominate export time for screenshot-heavy documents, so
+// the pictures are prepared on `pool`. Each result lands in its own
+// slot and the media names are handed out afterwards, in document order,
+// by DocumentXmlStream, so the package is the same whatever the number of
+// threads.
+QList<PreparedImage> prepareImages(const QTextDocument *doc,
+                                   QThreadPool *pool) {
+    QList<ImageSource> sources;
     for (QTextBlock block = doc->begin(); block.isValid();
          block = block.next()) {
+        for (QTextBlock::iterator it = block.begin(); !it.atEnd(); ++it) {
+            QTextFragment frag = it.fragment();
+            if (!frag.isValid()) continue;
+            QTextCharFormat cf = frag.charFormat();
+            if (!cf.isImageFormat()) continue;
+            const QTextImageFormat imgFmt = cf.toImageFormat();
+            ImageSource source;
+            source.name = imgFmt.name();
+            source.bytes = ImageStore::bytes(doc, source.name);
+            source.width = imgFmt.width();
+            source.height = imgFmt.height();
+            source.cx = imgFmt.longLongProperty(DocxExtentCx);
+            source.cy = imgFmt.longLongProperty(DocxExtentCy);
+            sources.append(source);
+        }
+    }
+
+    QList<PreparedImage> prepared(sources.size());
+    if (sources.size() == 1) {
+        prepared[0] = prepareImage(sources.at(0));
+    } else if (sources.size() > 1) {
+        for (int i = 0; i < sources.size(); ++i) {
+            pool->start(QRunnable::create([&sources, &prepared, i] {
+                prepared[i] = prepareImage(sources.at(i));
+            }));
+        }
+        pool->waitForDone();
+    }
+    return prepared;
+}
+
+// ─── Incremental save ──────────────────────────────────────────────────────
+
+// The .docx a save is about to replace. Its pictures are indexed by CRC-32
+// and size, both read from the central directory so nothing is
+// decompressed, and any picture the new package needs again is copied
+// across as it is, still compressed, instead of being packed again.
+class PreviousPackage {
+public:
+    PreviousPackage() { memset(&zip, 0, sizeof(zip)); }
+    ~PreviousPackage() { close(); }
+
+    // False (and nothing to reuse) if `filePath` isn't a readable zip
+    bool open(const QString &filePath) {
+        const QByteArray pathUtf8 = QFile::encodeName(filePath);
+        if (!QFileInfo::exists(filePath) ||
+            !mz_zip_reader_init_file(&zip, pathUtf8.constData(), 0))
+            return false;
+        opened = true;
+
+        const mz_uint count = mz_zip_reader_get_num_files(&zip);
+        for (mz_uint i = 0; i < count; ++i) {
+            mz_zip_archive_file_stat st;
+            if (!mz_zip_reader_file_stat(&zip, i, &st) || st.m_is_directory ||
+                !st.m_is_supported)
+                continue;
+            const QString name = QString::fromUtf8(st.m_filename);
+            // Only pictures our own content types cover
+            if (!name.startsWith(QLatin1String("word/media/")) ||
+                !isPictureSuffix(QFileInfo(name).suffix().toLower()))
+                continue;
+            const QPair<quint32, quint64> key(st.m_crc32, st.m_uncomp_size);
+            if (!media.contains(key)) {
+                media.insert(key, int(i));
+                names.insert(int(i), name.mid(5)); // relative to word/
+            }
+        }
+        return true;
+    }
+
+    // Must happen before the new file replaces this one
+    void close() {
+        if (opened) mz_zip_reader_end(&zip);
+        opened = false;
+    }
+
+    // Entry index of a picture with these contents, or -1. A CRC-32 and
+    // size match is taken as the same picture.
+    int find(quint32 crc32, quint64 size) const {
+        return media.value(qMakePair(crc32, size), -1);
+    }
+
+    QString mediaName(int index) const { return names.value(index); }
+
+    mz_zip_archive zip;
+
+private:
+    static bool isPictureSuffix(const QString &suffix) {
+        return suffix == QLatin1String("png") ||
+               suffix == QLatin1String("jpeg") ||
+               suffix == QLatin1String("jpg") ||
+               suffix == QLatin1String("gif");
+    }
+
+    QHash<QPair<quint32, quint64>, int> media;
+    QHash<int, QString> names;
+    bool opened = false;
+};
+
+// ─── Streaming word/document.xml ───────────────────────────────────────────
+
+// A picture referenced from document.xml, written into the package after it
+struct MediaEntry {
+    QString relId;       // "rId1", ...
+    QString mediaName;   // "media/image1.png"
+    ZipDeflate::Compressed data; // encoded image data, as packed
+    int previous = -1;   // copy this entry of the replaced file instead
+};
+
+// Produces word/document.xml a chunk at a time for ZipDeflate::Stream.
+// XML is generated a paragraph at a time only as the compressor asks for
+// more, and lands directly in one reused UTF-8 buffer of about
+// CHUNK_BYTES, so the memory held doesn't depend on the document's length.
+// Pictures met on the way take the next of `images` (from prepareImages())
+// and are appended to `media`.
+//
+// Adjacent fragments whose run properties are the same (QTextDocument
+// splits text on formatting .docx doesn't carry, e.g. font or colour) are
+// written as one <w:r>.
+class DocumentXmlStream {
+public:
+    static constexpr int CHUNK_BYTES = 64 * 1024;
+
+    DocumentXmlStream(const QTextDocument *doc,
+                      const QList<PreparedImage> &images,
+                      QList<MediaEntry> &media)
+        : doc(doc), images(images), media(media), block(doc->begin()) {
+        buffer.reserve(CHUNK_BYTES * 2);
+        // Pictures carried over keep their names; new ones must not
+        // take them
+        for (const PreparedImage &image : images) {
+            if (image.previous >= 0) takenNames.insert(image.previousName);
+        }
+    }
+
+    // The next piece of XML; empty once the document is finished. Valid
+    // until the next call.
+    const QByteArray &next() {
+        buffer.resize(0); // keeps the allocation
+        fill();
+        return buffer;
+    }
+
+private:
+    // Generate at least a chunk's worth, or whatever is left
+    void fill() {
+        if (stage == Header) {
+            xml.raw("<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+                    "<w:document "
+                    "xmlns:w=\"http://schemas.openxmlformats.org/wordprocessingml/2006/main\" "
+                    "xmlns:r=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships\" "
+                    "xmlns:wp=\"http://schemas.openxmlformats.org/drawingml/2006/wordprocessingDrawing\">"
+                    "<w:body>");
+            stage = Body;
+        }
+        while (stage == Body && buffer.size() < CHUNK_BYTES) {
+            if (!block.isValid()) {
+                xml.raw("<w:sectPr/></w:body></w:document>");
+                stage = Done;
+                break;
+            }
+            writeParagraph(block);
+            block = block.next();
+        }
+    }
+
+    // Run properties MattWord round-trips
+    enum RunProps { Bold = 1, Italic = 2, Underline = 4 };
+
+    static int runPropsOf(const QTextCharFormat &cf) {
+        int props = 0;
+        if (cf.fontWeight() >= QFont::Bold) props |= Bold;
+        if (cf.fontItalic()) props |= Italic;
+        if (cf.fontUnderline() ||
+            cf.underlineStyle() == QTextCharFormat::SingleUnderline)
+            props |= Underline;
+        return props;
+    }
+
+    // Continue the open run if it has the same properties, else start one
+    void beginRun(int props) {
+        if (runProps == props) return;
+        endRun();
+        xml.raw("<w:r>");
+        if (props) {
+            xml.raw("<w:rPr>");
+            if (props & Bold) xml.raw("<w:b/>");
+            if (props & Italic) xml.raw("<w:i/>");
+            if (props & Underline) xml.raw("<w:u w:val=\"single\"/>");
+            xml.raw("</w:rPr>");
+        }
+        runProps = props;
+    }
+
+    void endRun() {
+        if (runProps < 0) return;
+        if (inText) xml.raw("</w:t>");
+        xml.raw("</w:r>");
+        inText = false;
+        runProps = -1;
+    }
+
+    void writeText(QStringView text, int props) {
+        if (text.isEmpty()) return;
+        beginRun(props);
+        if (!inText) {
+            xml.raw("<w:t xml:space=\"preserve\">");
+            inText = true;
+        }
+        xml.text(text);
+    }
+
+    void writeBreak(int props) {
+        beginRun(props);
+        if (inText) {
+            xml.raw("</w:t>");
+            inText = false;
+        }
+        xml.raw("<w:br/>");
+    }
+
+    void writeParagraph(const QTextBlock &block) {
         // Explicit spacing properties: without these (and with no styles.xml
         // in our minimal package) Word applies its built-in Normal style —
         // 8pt space-after and 1.08 line spacing — visually inflating the
         // gaps between paragraphs. MattWord's model is "a blank line is its
         // own paragraph", so spacing must be zero and line rule single.
-        body += "<w:p><w:pPr>"
+        xml.raw("<w:p><w:pPr>"
                 "<w:spacing w:before=\"0\" w:after=\"0\" "
                 "w:line=\"240\" w:lineRule=\"auto\"/>"
-                "</w:pPr>";
+                "</w:pPr>");
+
+        // Fragments are read as views into the paragraph's text, copied
+        // once, rather than each as its own QString
+        const QString blockText = block.text();
+        const int blockPos = block.position();
 
         for (QTextBlock::iterator it = block.begin(); !it.atEnd(); ++it) {
             QTextFragment frag = it.fragment();
             if (!frag.isValid()) continue;
 
             QTextCharFormat cf = frag.charFormat();
-
             if (cf.isImageFormat()) {
-                // ── Inline image run ─────────────────────────────────────
-                QTextImageFormat imgFmt = cf.toImageFormat();
-                QString resName = imgFmt.name();
-
-                QVariant res = doc->resource(QTextDocument::ImageResource,
-                                             QUrl(resName));
-                QByteArray bytes;
-                QImage img;
-                if (res.typeId() == QMetaType::QByteArray) {
-                    bytes = res.toByteArray();
-                    img.loadFromData(bytes);
-                } else if (res.canConvert<QImage>()) {
-                    img = res.value<QImage>();
-                    QBuffer buf(&bytes);
-                    buf.open(QIODevice::WriteOnly);
-                    img.save(&buf, "PNG");
-                }
-                if (bytes.isEmpty() || img.isNull()) {
-                    qDebug() << "exportDocx: skipping unresolvable image"
-                             << resName;
-                    continue;
-                }
-
-                // Displayed size: honour the format's width; keep aspect.
-                // Sizes are forced to whole pixels and the bitmap is
-                // resampled to exactly the displayed size, so declared
-                // extent == intrinsic size == natural size and consumers
-                // can blit 1:1 (avoids seam artifacts in LO's scaler).
-                const int wPx = imgFmt.width() > 0
-                                    ? qRound(imgFmt.width())
-                                    : img.width();
-                const int hPx = imgFmt.height() > 0
-                                    ? qRound(imgFmt.height())
-                                    : (img.width() > 0
-                                           ? qRound(qreal(wPx) *
-                                                    img.height() /
-                                                    img.width())
-                                           : wPx);
-
-                if (img.width() != wPx || img.height() != hPx) {
-                    img = img.scaled(wPx, hPx, Qt::IgnoreAspectRatio,
-                                     Qt::SmoothTransformation);
-                }
-                // Deterministic pHYs: 3780 dpm (~96 dpi), matching the
-                // basis of our EMU extents. Canvas/pasted images can
-                // otherwise carry screen DPI, which makes Writer rescale.
-                img.setDotsPerMeterX(qRound(DOTS_PER_METER));
-                img.setDotsPerMeterY(qRound(DOTS_PER_METER));
-                {
-                    bytes.clear();
-                    QBuffer buf(&bytes);
-                    buf.open(QIODevice::WriteOnly);
-                    img.save(&buf, "PNG");
-                }
-
-                const qint64 cx = pxToEmu(wPx);
-                const qint64 cy = pxToEmu(hPx);
-
-                MediaEntry m;
-                m.relId = QStringLiteral("rId%1").arg(nextRel);
-                m.mediaName =
-                    QStringLiteral("media/image%1.png").arg(nextRel);
-                m.bytes = bytes;
-                media.append(m);
-                const int imgId = nextRel;
-                ++nextRel;
-
-                body += QStringLiteral(
-                    "<w:r><w:drawing>"
-                    "<wp:inline distT=\"0\" distB=\"0\" distL=\"0\" distR=\"0\">"
-                    "<wp:extent cx=\"%1\" cy=\"%2\"/>"
-                    "<wp:docPr id=\"%3\" name=\"Picture %3\"/>"
-                    "<a:graphic xmlns:a=\"http://schemas.openxmlformats.org/drawingml/2006/main\">"
-                    "<a:graphicData uri=\"http://schemas.openxmlformats.org/drawingml/2006/picture\">"
-                    "<pic:pic xmlns:pic=\"http://schemas.openxmlformats.org/drawingml/2006/picture\">"
-                    "<pic:nvPicPr><pic:cNvPr id=\"%3\" name=\"Picture %3\"/><pic:cNvPicPr/></pic:nvPicPr>"
-                    "<pic:blipFill><a:blip r:embed=\"%4\"/><a:stretch><a:fillRect/></a:stretch></pic:blipFill>"
-                    "<pic:spPr><a:xfrm><a:off x=\"0\" y=\"0\"/><a:ext cx=\"%1\" cy=\"%2\"/></a:xfrm>"
-                    "<a:prstGeom prst=\"rect\"><a:avLst/></a:prstGeom></pic:spPr>"
-                    "</pic:pic></a:graphicData></a:graphic>"
-                    "</wp:inline></w:drawing></w:r>")
-                        .arg(cx)
-                        .arg(cy)
-                        .arg(imgId)
-                        .arg(m.relId);
+                endRun();
+                writeImage();
                 continue;
             }
 
             // ── Text run ────────────────────────────────────────────────
-            QString text = frag.text();
             // QTextDocument represents soft line breaks (Shift+Enter) as
             // U+2028 inside a fragment; map them to <w:br/>
-            const QStringList parts =
-                text.split(QChar(QChar::LineSeparator));
-
-            QString rpr;
-            if (cf.fontWeight() >= QFont::Bold) rpr += "<w:b/>";
-            if (cf.fontItalic()) rpr += "<w:i/>";
-            if (cf.fontUnderline() ||
-                cf.underlineStyle() == QTextCharFormat::SingleUnderline)
-                rpr += "<w:u w:val=\"single\"/>";
-            const QString rprBlock =
-                rpr.isEmpty() ? QString()
-                              : QStringLiteral("<w:rPr>%1</w:rPr>").arg(rpr);
-
-            for (int p = 0; p < parts.size(); ++p) {
-                if (p > 0)
-                    body += QStringLiteral("<w:r>%1<w:br/></w:r>")
-                                .arg(rprBlock);
-                if (parts[p].isEmpty()) continue;
-                body += QStringLiteral(
-                            "<w:r>%1<w:t xml:space=\"preserve\">%2</w:t></w:r>")
-                            .arg(rprBlock, xmlEscape(parts[p]));
+            const int props = runPropsOf(cf);
+            QStringView text = QStringView(blockText).mid(
+                frag.position() - blockPos, frag.length());
+            for (qsizetype br; (br = text.indexOf(QChar(QChar::LineSeparator))) >= 0;) {
+                writeText(text.left(br), props);
+                writeBreak(props);
+                text = text.mid(br + 1);
             }
+            writeText(text, props);
         }
 
-        body += "</w:p>";
+        endRun();
+        xml.raw("</w:p>");
     }
 
-    QByteArray documentXml =
-        QByteArrayLiteral(
-            "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
-            "<w:document "
-            "xmlns:w=\"http://schemas.openxmlformats.org/wordprocessingml/2006/main\" "
-            "xmlns:r=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships\" "
-            "xmlns:wp=\"http://schemas.openxmlformats.org/drawingml/2006/wordprocessingDrawing\">"
-            "<w:body>") +
-        body.toUtf8() +
-        QByteArrayLiteral("<w:sectPr/></w:body></w:document>");
+    void writeImage() {
+        // ── Inline image run ─────────────────────────────────────────────
+        const PreparedImage &prepared = images.at(nextImage++);
+        if (prepared.bytes.isEmpty()) return;
+        const qint64 cx = prepared.cx;
+        const qint64 cy = prepared.cy;
+
+        const int imgId = media.size() + 1;
+        MediaEntry m;
+        m.relId = QStringLiteral("rId%1").arg(imgId);
+        if (prepared.previous >= 0) {
+            m.mediaName = prepared.previousName;
+            m.previous = prepared.previous;
+        } else {
+            do {
+                m.mediaName = QStringLiteral("media/image%1.%2")
+                                  .arg(nextMediaNumber++)
+                                  .arg(ImageIngest::suffixFor(prepared.format));
+            } while (takenNames.contains(m.mediaName));
+            m.data = prepared.packed;
+        }
+        media.append(m);
+
+        xml.raw("<w:r><w:drawing>"
+                "<wp:inline distT=\"0\" distB=\"0\" distL=\"0\" distR=\"0\">"
+                "<wp:extent cx=\"");
+        xml.number(cx);
+        xml.raw("\" cy=\"");
+        xml.number(cy);
+        xml.raw("\"/><wp:docPr id=\"");
+        xml.number(imgId);
+        xml.raw("\" name=\"Picture ");
+        xml.number(imgId);
+        xml.raw("\"/>"
+                "<a:graphic xmlns:a=\"http://schemas.openxmlformats.org/drawingml/2006/main\">"
+                "<a:graphicData uri=\"http://schemas.openxmlformats.org/drawingml/2006/picture\">"
+                "<pic:pic xmlns:pic=\"http://schemas.openxmlformats.org/drawingml/2006/picture\">"
+                "<pic:nvPicPr><pic:cNvPr id=\"");
+        xml.number(imgId);
+        xml.raw("\" name=\"Picture ");
+        xml.number(imgId);
+        xml.raw("\"/><pic:cNvPicPr/></pic:nvPicPr>"
+                "<pic:blipFill><a:blip r:embed=\"");
+        xml.raw(m.relId.toLatin1());
+        xml.raw("\"/><a:stretch><a:fillRect/></a:stretch></pic:blipFill>"
+                "<pic:spPr><a:xfrm><a:off x=\"0\" y=\"0\"/><a:ext cx=\"");
+        xml.number(cx);
+        xml.raw("\" cy=\"");
+        xml.number(cy);
+        xml.raw("\"/></a:xfrm>"
+                "<a:prstGeom prst=\"rect\"><a:avLst/></a:prstGeom></pic:spPr>"
+                "</pic:pic></a:graphicData></a:graphic>"
+                "</wp:inline></w:drawing></w:r>");
+    }
+
+    enum Stage { Header, Body, Done };
+
+    const QTextDocument *doc;
+    const QList<PreparedImage> &images;
+    QList<MediaEntry> &media;
+    QTextBlock block;       // next paragraph to write
+    int nextImage = 0;      // index into images
+    int nextMediaNumber = 1; // for media/imageN names
+    QSet<QString> takenNames; // by pictures from the replaced file
+    Stage stage = Header;
+    QByteArray buffer;
+    XmlWriter xml{buffer};
+    int runProps = -1;      // properties of the open <w:r>, -1 if none
+    bool inText = false;    // inside its <w:t>
+};
+
+} // anonymous namespace
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Export
+// ═══════════════════════════════════════════════════════════════════════════
+
+bool DocxConverter::exportDocx(const QTextDocument *doc,
+                               const QString &filePath, QString *errorOut) {
+    if (!doc) {
+        if (errorOut) *errorOut = QStringLiteral("No document to export.");
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // The package is written beside the target and renamed over it once
+    // complete, so an existing file can be read from until then
+    QSaveFile file(filePath);
+    mz_zip_archive zip;
+    memset(&zip, 0, sizeof(zip));
+    zip.m_pWrite = &writeToFile;
+    zip.m_pIO_opaque = &file;
+    if (!file.open(QIODevice::WriteOnly) || !mz_zip_writer_init_v2(&zip, 0, 0)) {
+        if (errorOut)
+            *errorOut =
+                QStringLiteral("Cannot create file %1").arg(filePath);
+        return false;
+    }
+    PreviousPackage previous;
+    previous.open(filePath);
+
+    // One mode for the whole package, even if the setting changes meanwhile
+    const CompressionPolicy::Mode mode = CompressionPolicy::mode();
+
+    // Pictures, then document.xml, are compressed on the pool
+    QThreadPool pool;
+    QList<PreparedImage> images = prepareImages(doc, &pool);
+    for (PreparedImage &image : images) {
+        if (image.bytes.isEmpty()) continue;
+        image.previous = previous.find(image.packed.crc32, image.packed.size);
+        if (image.previous >= 0)
+            image.previousName = previous.mediaName(image.previous);
+    }
+
+    bool ok = zipAdd(&zip, "[Content_Types].xml", contentTypesXml(), mode) &&
+              zipAdd(&zip, "_rels/.rels", rootRelsXml(), mode);
+
+    // document.xml is compressed as it's generated: each filled chunk
+    // goes to the pool while the next is written, and is written to the
+    // file as soon as it's compressed, so neither form is ever kept whole
+    QList<MediaEntry> media;
+    if (ok) {
+        DocumentXmlStream xml(doc, images, media);
+        ZipDeflate::EntryWriter entry(&zip, "word/document.xml");
+        // The level is judged from the first piece: the header and the
+        // opening paragraphs
+        const QByteArray *piece = &xml.next();
+        ZipDeflate::Stream deflater(
+            CompressionPolicy::levelFor(*piece, false, mode), &pool,
+            [&entry](const QByteArray &compressed) {
+                return entry.write(compressed);
+            });
+        for (; !piece->isEmpty(); piece = &xml.next())
+            deflater.write(*piece);
+        ok = entry.finish(deflater.finish());
+    }
 
     // word/_rels/document.xml.rels — image relationships
     QString rels =
@@ -304,30 +816,30 @@ bool DocxConverter::exportDocx(const QTextDocument *doc,
     }
     rels += "</Relationships>";
 
-    // ── Write the zip ──────────────────────────────────────────────────────
-    mz_zip_archive zip;
-    memset(&zip, 0, sizeof(zip));
-    const QByteArray pathUtf8 = QFile::encodeName(filePath);
-    if (!mz_zip_writer_init_file(&zip, pathUtf8.constData(), 0)) {
-        if (errorOut)
-            *errorOut =
-                QStringLiteral("Cannot create file %1").arg(filePath);
-        return false;
-    }
-
-    bool ok = zipAdd(&zip, "[Content_Types].xml", contentTypesXml()) &&
-              zipAdd(&zip, "_rels/.rels", rootRelsXml()) &&
-              zipAdd(&zip, "word/document.xml", documentXml) &&
-              zipAdd(&zip, "word/settings.xml", settingsXml()) &&
-              zipAdd(&zip, "word/_rels/document.xml.rels", rels.toUtf8());
+    ok = ok &&
+         zipAdd(&zip, "word/settings.xml", settingsXml(), mode) &&
+         zipAdd(&zip, "word/_rels/document.xml.rels", rels.toUtf8(), mode);
+    // A carried-over picture used more than once is copied once
+    QSet<QString> written;
     for (const MediaEntry &m : media) {
         if (!ok) break;
-        ok = zipAdd(&zip, ("word/" + m.mediaName).toUtf8().constData(),
-                    m.bytes);
+        if (written.contains(m.mediaName)) continue;
+        written.insert(m.mediaName);
+        if (m.previous >= 0) {
+            ok = mz_zip_writer_add_from_zip_reader(&zip, &previous.zip,
+                                                   mz_uint(m.previous)) !=
+                 MZ_FALSE;
+        } else {
+            ok = ZipDeflate::addToZip(
+                &zip, ("word/" + m.mediaName).toUtf8().constData(), m.data);
+        }
     }
 
     ok = mz_zip_writer_finalize_archive(&zip) && ok;
     mz_zip_writer_end(&zip);
+    previous.close();
+    ok = ok && file.commit();
+    // qDebug() << "exportDocx took:" << timer.elapsed() << "ms";
 
     if (!ok && errorOut)
         *errorOut = QStringLiteral("Failed writing docx archive.");
@@ -340,21 +852,222 @@ bool DocxConverter::exportDocx(const QTextDocument *doc,
 
 namespace {
 
-// Parse word/_rels/document.xml.rels → relId -> target ("media/image1.png")
-QHash<QString, QString> parseRels(const QByteArray &xml) {
+QMutex limitsMutex;
+DocxConverter::ImportLimits currentLimits; // guarded by limitsMutex
+
+// Entries up to this size are never held to ImportLimits::maxRatio: a
+// small, highly repetitive part can legitimately compress very well
+constexpr quint64 RATIO_EXEMPT_BYTES = 1024 * 1024;
+
+// Check the sizes the central directory declares against `limits`. miniz
+// never inflates an entry past its declared size, so these bound what
+// reading the package can allocate.
+bool checkPackageLimits(mz_zip_archive *zip,
+                        const DocxConverter::ImportLimits &limits,
+                        QString *errorOut) {
+    quint64 total = 0;
+    const mz_uint count = mz_zip_reader_get_num_files(zip);
+    for (mz_uint i = 0; i < count; ++i) {
+        mz_zip_archive_file_stat st;
+        if (!mz_zip_reader_file_stat(zip, i, &st)) continue;
+        total += st.m_uncomp_size;
+        if (st.m_uncomp_size > RATIO_EXEMPT_BYTES &&
+            st.m_uncomp_size > st.m_comp_size * quint64(limits.maxRatio)) {
+            if (errorOut)
+                *errorOut = QStringLiteral(
+                                "%1 expands more than %2 times over, past "
+                                "the import limit; the file may be a zip "
+                                "bomb.")
+                                .arg(QString::fromUtf8(st.m_filename))
+                                .arg(limits.maxRatio);
+            return false;
+        }
+    }
+    if (total > quint64(limits.maxTotalBytes)) {
+        if (errorOut)
+            *errorOut = QStringLiteral(
+                            "The file expands to %1 MB, over the import "
+                            "limit of %2 MB.")
+                            .arg(total >> 20)
+                            .arg(limits.maxTotalBytes >> 20);
+        return false;
+    }
+    return true;
+}
+
+// Parse word/_rels/document.xml.rels → relId -> target ("media/image1.png").
+// The targets of image relationships also go to *imageTargets, once each,
+// in the order they're listed.
+QHash<QString, QString> parseRels(const QByteArray &xml,
+                                  QStringList *imageTargets = nullptr) {
     QHash<QString, QString> map;
     QXmlStreamReader r(xml);
     while (!r.atEnd()) {
         r.readNext();
         if (r.isStartElement() &&
             r.name() == QLatin1String("Relationship")) {
-            map.insert(r.attributes().value("Id").toString(),
-                       r.attributes().value("Target").toString());
+            const QString target = r.attributes().value("Target").toString();
+            map.insert(r.attributes().value("Id").toString(), target);
+            if (imageTargets &&
+                r.attributes().value("Type").endsWith(QLatin1String("/image")) &&
+                !imageTargets->contains(target))
+                imageTargets->append(target);
         }
     }
     return map;
 }
 
+// The suffix a picture's resource name gets, from its part name: media
+// the editor doesn't keep as they are will have been converted to PNG
+QString suffixForPart(const QString &target) {
+    QByteArray format = QFileInfo(target).suffix().toLower().toLatin1();
+    if (format == "jpg") format = "jpeg";
+    if (!ImageIngest::isPassthroughFormat(format)) format = "png";
+    return ImageIngest::suffixFor(format);
+}
+
+// ─── Package file ──────────────────────────────────────────────────────────
+
+// The .docx being imported, mapped into memory once and read by every
+// miniz reader through mz_zip_reader_init_mem(): the central directory and
+// stored entries are plain memory reads, and compressed entries inflate
+// straight from the mapped pages, with no stdio buffer or read() call in
+// between. Any number of readers, on any threads, can share the mapping.
+// Where the file can't be mapped it is read into memory instead.
+class MappedPackage {
+public:
+    bool open(const QString &filePath) {
+        file.setFileName(filePath);
+        if (!file.open(QIODevice::ReadOnly)) return false;
+        size = file.size();
+        if (size > 0) data = file.map(0, size);
+        if (!data) {
+            contents = file.readAll();
+            if (contents.size() != size) return false;
+            data = reinterpret_cast<const uchar *>(contents.constData());
+        }
+        return true;
+    }
+
+    QString errorString() const { return file.errorString(); }
+
+    // A reader of its own for the caller, who must mz_zip_reader_end() it
+    bool openReader(mz_zip_archive *zip) const {
+        memset(zip, 0, sizeof(*zip));
+        return data && mz_zip_reader_init_mem(zip, data, size_t(size), 0);
+    }
+
+private:
+    QFile file;
+    QByteArray contents;     // the fallback when mapping fails
+    const uchar *data = nullptr;
+    qint64 size = 0;
+};
+
+// ─── Media ─────────────────────────────────────────────────────────────────
+
+// The package's pictures, read on a pool while document.xml is walked.
+// The parts are dealt out round-robin in relationship order (roughly
+// document order) to one job per thread, and each job opens its own
+// reader on the mapping: a miniz archive can't be read from two threads.
+// Pictures outlive the import as document resources, so even stored ones
+// are copied out of the mapping rather than referenced in place.
+class MediaLoader {
+public:
+    struct Media {
+        QByteArray bytes;    // as stored, or converted; empty if unreadable
+        QSize size;          // header probe
+        QString error;       // set if it's over the pixel limit
+    };
+
+    MediaLoader(const MappedPackage &package, const QStringList &targets,
+                qint64 maxImagePixels, QThreadPool *pool)
+        : targets(targets), maxImagePixels(maxImagePixels),
+          results(targets.size()), done(targets.size(), false) {
+        for (int i = 0; i < targets.size(); ++i) index.insert(targets.at(i), i);
+        const int jobs =
+            int(qMin<qsizetype>(targets.size(), qMax(1, pool->maxThreadCount())));
+        for (int j = 0; j < jobs; ++j) {
+            pool->start(QRunnable::create([this, &package, j, jobs] {
+                run(package, j, jobs);
+            }));
+        }
+    }
+
+    // The jobs write into this object
+    ~MediaLoader() {
+        for (int i = 0; i < targets.size(); ++i) wait(i);
+    }
+
+    // Skip the pictures no job has started on yet
+    void cancel() { canceled.store(true, std::memory_order_relaxed); }
+
+    // -1 if `target` isn't an image relationship's
+    int indexOf(const QString &target) const { return index.value(target, -1); }
+
+    // Block until picture `i` has been read
+    Media wait(int i) {
+        QMutexLocker lock(&mutex);
+        while (!done.at(i)) ready.wait(&mutex);
+        return results.at(i);
+    }
+
+private:
+    void run(const MappedPackage &package, int first, int step) {
+        mz_zip_archive zip;
+        const bool opened = package.openReader(&zip);
+        for (int i = first; i < targets.size(); i += step) {
+            Media media;
+            if (opened && !canceled.load(std::memory_order_relaxed))
+                media = load(&zip, targets.at(i), maxImagePixels);
+            QMutexLocker lock(&mutex);
+            results[i] = media;
+            done[i] = true;
+            ready.wakeAll();
+        }
+        if (opened) mz_zip_reader_end(&zip);
+    }
+
+    // The part itself, undecoded whatever its pixel size. Only containers
+    // the editor doesn't keep (BMP, TIFF, ...) are converted.
+    static Media load(mz_zip_archive *zip, const QString &target,
+                      qint64 maxImagePixels) {
+        bool found = false;
+        QByteArray bytes =
+            zipRead(zip, QStringLiteral("word/") + target, &found);
+        if (!found) // some producers use absolute-ish paths
+            bytes = zipRead(zip, target, &found);
+        if (!found || bytes.isEmpty()) return {};
+
+        Media media;
+        media.size = ImageIngest::intrinsicSize(bytes); // QImageReader::size()
+        if (qint64(media.size.width()) * media.size.height() > maxImagePixels) {
+            media.error = QStringLiteral(
+                              "%1 is %2 × %3 pixels, over the import limit "
+                              "of %4 megapixels.")
+                              .arg(target)
+                              .arg(media.size.width())
+                              .arg(media.size.height())
+                              .arg(maxImagePixels / 1000000);
+            return media;
+        }
+        QByteArray format = ImageIngest::formatOf(bytes);
+        if (!ImageIngest::isPassthroughFormat(format))
+            bytes = ImageIngest::ingest(bytes, 0, &format);
+        if (media.size.isValid()) media.bytes = bytes;
+        return media;
+    }
+
+    const QStringList targets;
+    const qint64 maxImagePixels;
+    QHash<QString, int> index;
+    QMutex mutex;
+    QWaitCondition ready;
+    QList<Media> results;    // guarded by `mutex`, as is `done`
+    QList<bool> done;
+    std::atomic<bool> canceled{false};
+};
+
 struct RunProps {
     bool bold = false;
     bool italic = false;
@@ -369,78 +1082,246 @@ bool ooxmlFlagOn(QXmlStreamReader &r) {
              val == QLatin1String("none"));
 }
 
-} // anonymous namespace
+// A picture as found in document.xml. Its bytes, the media part as it is
+// stored in the package, follow through resolveImage(): nothing is decoded
+// on import, the editor decodes a picture at display size the first time
+// it paints it.
+struct ImportedImage {
+    QString resName;     // "myimage/docximg_N.suffix"
+    int widthPx = 0;     // displayed size
+    int heightPx = 0;
+    qint64 cx = 0;       // wp:extent, EMU; 0 if the drawing gave none
+    qint64 cy = 0;
+};
 
-bool DocxConverter::importDocx(const QString &filePath, QString &htmlOut,
-                               QHash<QString, QByteArray> &imagesOut,
-                               QString *errorOut) {
-    htmlOut.clear();
-    imagesOut.clear();
+// Receives what walkDocument() finds, in document order: each paragraph
+// as beginParagraph(), its content through text(), lineBreak(), tab() and
+// image(), then endParagraph(). Once the walk is over, every image() gets
+// its bytes through resolveImage(), or empty bytes if the picture
+// couldn't be read, in which case it is taken out again.
+class ImportSink {
+public:
+    virtual ~ImportSink() = default;
+    virtual void beginParagraph() {}
+    virtual void text(const QString &text, const RunProps &props) = 0;
+    virtual void lineBreak() = 0;
+    virtual void tab() = 0;
+    virtual void image(const ImportedImage &image) = 0;
+    virtual void endParagraph(bool hasContent) = 0;
+    virtual void resolveImage(const QString &resName,
+                              const QByteArray &bytes) = 0;
+};
 
-    mz_zip_archive zip;
-    memset(&zip, 0, sizeof(zip));
-    const QByteArray pathUtf8 = QFile::encodeName(filePath);
-    if (!mz_zip_reader_init_file(&zip, pathUtf8.constData(), 0)) {
-        if (errorOut)
-            *errorOut = QStringLiteral(
-                            "%1 is not a valid .docx (zip) file.")
-                            .arg(QFileInfo(filePath).fileName());
-        return false;
+// ─── HTML ──────────────────────────────────────────────────────────────────
+
+class HtmlSink : public ImportSink {
+public:
+    HtmlSink(QString &html, QHash<QString, QByteArray> &images)
+        : html(html), images(images) {
+        html += "<html><body>";
     }
 
-    bool found = false;
-    const QByteArray documentXml =
-        zipRead(&zip, QStringLiteral("word/document.xml"), &found);
-    if (!found) {
-        mz_zip_reader_end(&zip);
-        if (errorOut)
-            *errorOut = QStringLiteral(
-                "No word/document.xml inside the file — not a .docx?");
-        return false;
+    void text(const QString &text, const RunProps &p) override {
+        if (p.bold) para += "<b>";
+        if (p.italic) para += "<i>";
+        if (p.underline) para += "<u>";
+        para += xmlEscape(text);
+        if (p.underline) para += "</u>";
+        if (p.italic) para += "</i>";
+        if (p.bold) para += "</b>";
     }
 
-    bool relsFound = false;
-    const QHash<QString, QString> rels = parseRels(zipRead(
-        &zip, QStringLiteral("word/_rels/document.xml.rels"), &relsFound));
+    void lineBreak() override { para += "<br/>"; }
 
-    // ── Walk document.xml ─────────────────────────────────────────────────
-    QString html;
-    html += "<html><body>";
+    // Approximate a tab; QTextEdit HTML has no real tab stop
+    void tab() override { para += "&nbsp;&nbsp;&nbsp;&nbsp;"; }
 
-    QXmlStreamReader r(documentXml);
-    int imgCounter = 0;
+    void image(const ImportedImage &image) override {
+        const QString tag =
+            QStringLiteral("<img src=\"%1\" width=\"%2\" height=\"%3\"/>")
+                .arg(image.resName)
+                .arg(image.widthPx)
+                .arg(image.heightPx);
+        tags.insert(image.resName, tag);
+        para += tag;
+    }
 
+    void endParagraph(bool hasContent) override {
+        // margin:0 — Qt's setHtml() otherwise gives every <p> a
+        // default 12px top+bottom margin (uncollapsed), which shows
+        // up as ~2 blank lines between paragraphs in the editor.
+        html += "<p style=\"margin-top:0px; margin-bottom:0px;\">";
+        html += hasContent ? para : QStringLiteral("<br/>");
+        html += "</p>";
+        para.clear();
+    }
+
+    // An unreadable picture's tag is taken out again; the resource name
+    // in it makes it unique
+    void resolveImage(const QString &resName,
+                      const QByteArray &bytes) override {
+        if (!bytes.isEmpty()) images.insert(resName, bytes);
+        else html.remove(tags.value(resName));
+    }
+
+    void finish() { html += "</body></html>"; }
+
+private:
+    QString &html;
+    QHash<QString, QByteArray> &images;
     QString para;            // accumulated HTML for current paragraph
+    QHash<QString, QString> tags; // resName -> its <img> tag
+};
+
+// ─── QTextDocument ─────────────────────────────────────────────────────────
+
+// Builds the document directly: one block per paragraph, runs inserted
+// with their character format, all in one edit block so the layout runs
+// once at the end. Blocks get the default (zero-margin) format, which is
+// what the HTML route's margin:0 paragraphs end up as.
+class DocumentSink : public ImportSink {
+public:
+    explicit DocumentSink(QTextDocument *doc) : doc(doc), cursor(doc) {
+        cursor.beginEditBlock();
+    }
+
+    // Unreadable pictures are taken out last to first, so the positions
+    // of the others stay put
+    void finish() {
+        for (auto it = placed.crbegin(); it != placed.crend(); ++it) {
+            if (!unresolved.contains(it->second)) continue;
+            QTextCursor c(doc);
+            c.setPosition(it->first);
+            c.deleteChar();
+        }
+        cursor.endEditBlock();
+    }
+
+    // The document's first block is used as it is
+    void beginParagraph() override {
+        if (!pendingBlock) return;
+        cursor.insertBlock(QTextBlockFormat(), QTextCharFormat());
+        pendingBlock = false;
+    }
+
+    void text(const QString &text, const RunProps &p) override {
+        QTextCharFormat fmt;
+        if (p.bold) fmt.setFontWeight(QFont::Bold);
+        if (p.italic) fmt.setFontItalic(true);
+        if (p.underline) fmt.setFontUnderline(true);
+        cursor.insertText(text, fmt);
+    }
+
+    void lineBreak() override {
+        cursor.insertText(QString(QChar(QChar::LineSeparator)));
+    }
+
+    // Same approximation as the HTML route: four no-break spaces
+    void tab() override { cursor.insertText(QString(4, QChar(0x00A0))); }
+
+    // Width and height are both set, so laying the picture out never
+    // needs to look at its bytes
+    void image(const ImportedImage &image) override {
+        QTextImageFormat fmt;
+        fmt.setName(image.resName);
+        fmt.setWidth(image.widthPx);
+        fmt.setHeight(image.heightPx);
+        if (image.cx > 0 && image.cy > 0) {
+            fmt.setProperty(DocxExtentCx, image.cx);
+            fmt.setProperty(DocxExtentCy, image.cy);
+        }
+        placed.append({cursor.position(), image.resName});
+        cursor.insertImage(fmt);
+    }
+
+    // Empty paragraphs stay empty blocks
+    void endParagraph(bool) override { pendingBlock = true; }
+
+    void resolveImage(const QString &resName,
+                      const QByteArray &bytes) override {
+        if (!bytes.isEmpty()) ImageStore::add(doc, resName, bytes);
+        else unresolved.insert(resName);
+    }
+
+private:
+    QTextDocument *doc;
+    QTextCursor cursor;
+    bool pendingBlock = false;
+    QList<QPair<int, QString>> placed; // position of each image() and name
+    QSet<QString> unresolved;
+};
+
+// Walk document.xml, taking pictures from `media` as they are referenced.
+// document.xml is fed to the parser as it inflates, so only a piece of
+// the XML is held at a time, not the whole of it. Pictures are placed
+// with their wp:extent size while `media` reads them, and their bytes
+// handed to the sink at the end; the walk only waits for a picture early
+// when the drawing gives no size.
+bool walkDocument(ZipEntryReader &documentXml,
+                  const QHash<QString, QString> &rels, MediaLoader &media,
+                  ImportSink &sink, const DocxConverter::ImportLimits &limits,
+                  QString *errorOut,
+                  const DocxConverter::ImportProgressCallback &progress = {},
+                  const std::atomic<bool> *cancel = nullptr) {
+    QXmlStreamReader r;
+    int imgCounter = 0;
+    DocxConverter::ImportProgress status;
+    status.bytesTotal = documentXml.size();
+    bool canceled = false;
+    QString limitError;      // the first limit the file goes over
+    QList<QPair<QString, int>> placed; // resName, media index
+
     bool paraHasContent = false;
     RunProps props;          // formatting of the run being parsed
     bool inRun = false;
+    bool inText = false;     // inside <w:t>; its text may span pieces
+    QString text;
     qint64 pendingExtentCx = 0; // wp:extent precedes a:blip in OOXML; hold
-                                // the display width until the image arrives
-
-    auto openTags = [](const RunProps &p) {
-        QString s;
-        if (p.bold) s += "<b>";
-        if (p.italic) s += "<i>";
-        if (p.underline) s += "<u>";
-        return s;
-    };
-    auto closeTags = [](const RunProps &p) {
-        QString s;
-        if (p.underline) s += "</u>";
-        if (p.italic) s += "</i>";
-        if (p.bold) s += "</b>";
-        return s;
-    };
+    qint64 pendingExtentCy = 0; // the display size until the image arrives
 
-    while (!r.atEnd()) {
-        r.readNext();
+    for (;;) {
+        const QXmlStreamReader::TokenType token = r.readNext();
+        if (token == QXmlStreamReader::Invalid) {
+            // Out of input: feed the next piece and carry on
+            if (r.error() != QXmlStreamReader::PrematureEndOfDocumentError)
+                break;
+            if (cancel && cancel->load(std::memory_order_relaxed)) {
+                canceled = true;
+                media.cancel();
+                documentXml.abandon();
+                break;
+            }
+            const QByteArray piece = documentXml.next();
+            if (piece.isEmpty()) break;
+            r.addData(piece);
+            if (progress) {
+                status.bytesInflated = documentXml.bytesRead();
+                progress(status);
+            }
+            continue;
+        }
+        if (token == QXmlStreamReader::EndDocument) break;
+
+        if (inText && r.isCharacters()) {
+            text += r.text();
+            continue;
+        }
 
         if (r.isStartElement()) {
             const auto name = r.name();
 
             if (name == QLatin1String("p")) {
-                para.clear();
+                if (++status.paragraphs > limits.maxParagraphs) {
+                    limitError = QStringLiteral(
+                                     "The document has more than %1 "
+                                     "paragraphs, the import limit.")
+                                     .arg(limits.maxParagraphs);
+                    media.cancel();
+                    documentXml.abandon();
+                    break;
+                }
                 paraHasContent = false;
+                sink.beginParagraph();
             } else if (name == QLatin1String("r")) {
                 inRun = true;
                 props = RunProps();
@@ -452,93 +1333,238 @@ bool DocxConverter::importDocx(const QString &filePath, QString &htmlOut,
                 const auto v = r.attributes().value("w:val");
                 props.underline = !(v == QLatin1String("none"));
             } else if (name == QLatin1String("t")) {
-                const QString text = r.readElementText();
-                if (!text.isEmpty()) {
-                    para += openTags(props) + xmlEscape(text) +
-                            closeTags(props);
-                    paraHasContent = true;
-                }
+                inText = true;
+                text.clear();
             } else if (name == QLatin1String("br") ||
                        name == QLatin1String("cr")) {
-                para += "<br/>";
+                sink.lineBreak();
                 paraHasContent = true;
             } else if (name == QLatin1String("tab")) {
-                // Approximate a tab; QTextEdit HTML has no real tab stop
-                para += "&nbsp;&nbsp;&nbsp;&nbsp;";
+                sink.tab();
                 paraHasContent = true;
             } else if (name == QLatin1String("extent")) {
                 // wp:extent (displayed size in EMU) precedes a:blip inside
                 // w:drawing — remember it for the upcoming image
-                bool okCx = false;
+                bool okCx = false, okCy = false;
                 const qint64 cx =
                     r.attributes().value("cx").toLongLong(&okCx);
+                const qint64 cy =
+                    r.attributes().value("cy").toLongLong(&okCy);
                 if (okCx && cx > 0) pendingExtentCx = cx;
+                if (okCy && cy > 0) pendingExtentCy = cy;
             } else if (name == QLatin1String("blip")) {
                 // <a:blip r:embed="rIdN"/> inside w:drawing (or w:pict)
                 const QString relId =
                     r.attributes().value("r:embed").toString();
-                const QString target = rels.value(relId);
-                if (!target.isEmpty()) {
-                    bool mediaFound = false;
-                    QByteArray bytes = zipRead(
-                        &zip, QStringLiteral("word/") + target,
-                        &mediaFound);
-                    if (!mediaFound) // some producers use absolute-ish paths
-                        bytes = zipRead(&zip, target, &mediaFound);
-                    if (mediaFound && !bytes.isEmpty()) {
-                        const QString resName =
-                            QStringLiteral("myimage/docximg_%1.png")
-                                .arg(imgCounter++);
-                        // Re-encode to PNG so downstream save-as-HTML
-                        // (which labels everything image/png) stays honest
-                        QImage img;
-                        img.loadFromData(bytes);
-                        if (!img.isNull()) {
-                            QByteArray png;
-                            QBuffer buf(&png);
-                            buf.open(QIODevice::WriteOnly);
-                            img.save(&buf, "PNG");
-                            imagesOut.insert(resName, png);
-
-                            const int widthPx =
-                                pendingExtentCx > 0
-                                    ? emuToPx(pendingExtentCx)
-                                    : img.width();
-                            para += QStringLiteral(
-                                        "<img src=\"%1\" width=\"%2\"/>")
-                                        .arg(resName)
-                                        .arg(widthPx);
-                            paraHasContent = true;
-                        }
+                const int index = media.indexOf(rels.value(relId));
+                if (index >= 0) {
+                    ImportedImage image;
+                    image.cx = pendingExtentCx;
+                    image.cy = pendingExtentCy;
+                    // Displayed size from wp:extent, or failing that the
+                    // picture's own
+                    QSize shown;
+                    if (image.cx > 0 && image.cy > 0) {
+                        shown = QSize(emuToPx(image.cx), emuToPx(image.cy));
+                    } else {
+                        shown = media.wait(index).size;
+                        image.cx = image.cy = 0;
+                    }
+                    if (shown.isValid() && !shown.isEmpty()) {
+                        image.resName =
+                            QStringLiteral("myimage/docximg_%1.%2")
+                                .arg(imgCounter++)
+                                .arg(suffixForPart(rels.value(relId)));
+                        image.widthPx = shown.width();
+                        image.heightPx = shown.height();
+                        sink.image(image);
+                        placed.append({image.resName, index});
+                        paraHasContent = true;
                     }
                 }
-                pendingExtentCx = 0; // consumed
+                pendingExtentCx = pendingExtentCy = 0; // consumed
             }
         } else if (r.isEndElement()) {
             const auto name = r.name();
-            if (name == QLatin1String("r")) {
+            if (name == QLatin1String("t")) {
+                inText = false;
+                if (!text.isEmpty()) {
+                    sink.text(text, props);
+                    paraHasContent = true;
+                }
+            } else if (name == QLatin1String("r")) {
                 inRun = false;
             } else if (name == QLatin1String("p")) {
-                // margin:0 — Qt's setHtml() otherwise gives every <p> a
-                // default 12px top+bottom margin (uncollapsed), which shows
-                // up as ~2 blank lines between paragraphs in the editor.
-                html += "<p style=\"margin-top:0px; margin-bottom:0px;\">";
-                html += paraHasContent ? para : QStringLiteral("<br/>");
-                html += "</p>";
+                sink.endParagraph(paraHasContent);
             }
         }
     }
 
-    mz_zip_reader_end(&zip);
+    for (const auto &p : placed) {
+        const MediaLoader::Media m = media.wait(p.second);
+        if (limitError.isEmpty()) limitError = m.error;
+        sink.resolveImage(p.first, m.bytes);
+    }
 
+    if (!limitError.isEmpty()) {
+        if (errorOut) *errorOut = limitError;
+        return false;
+    }
+    if (canceled) {
+        if (errorOut) *errorOut = QStringLiteral("Opening canceled.");
+        return false;
+    }
     if (r.hasError()) {
         if (errorOut)
             *errorOut = QStringLiteral("XML error in document.xml: %1")
                             .arg(r.errorString());
         return false;
     }
+    if (!documentXml.finish()) {
+        if (errorOut)
+            *errorOut = QStringLiteral("document.xml is damaged.");
+        return false;
+    }
+    return true;
+}
+
+// Map `filePath` and read what every import needs up front. On success
+// the caller owns `zip` and must mz_zip_reader_end() it before `package`
+// goes away.
+bool openPackage(const QString &filePath, MappedPackage &package,
+                 mz_zip_archive &zip, mz_uint &documentIndex,
+                 QHash<QString, QString> &rels, QStringList &imageTargets,
+                 const DocxConverter::ImportLimits &limits,
+                 QString *errorOut) {
+    if (!package.open(filePath)) {
+        if (errorOut)
+            *errorOut = QStringLiteral("Cannot open file: ") +
+                        package.errorString();
+        return false;
+    }
+    if (!package.openReader(&zip)) {
+        if (errorOut)
+            *errorOut = QStringLiteral(
+                            "%1 is not a valid .docx (zip) file.")
+                            .arg(QFileInfo(filePath).fileName());
+        return false;
+    }
+    if (!checkPackageLimits(&zip, limits, errorOut)) {
+        mz_zip_reader_end(&zip);
+        return false;
+    }
+
+    const int idx =
+        mz_zip_reader_locate_file(&zip, "word/document.xml", nullptr, 0);
+    if (idx < 0) {
+        mz_zip_reader_end(&zip);
+        if (errorOut)
+            *errorOut = QStringLiteral(
+                "No word/document.xml inside the file — not a .docx?");
+        return false;
+    }
+    documentIndex = mz_uint(idx);
+
+    bool relsFound = false;
+    rels = parseRels(zipRead(
+        &zip, QStringLiteral("word/_rels/document.xml.rels"), &relsFound),
+        &imageTargets);
+    return true;
+}
+
+} // anonymous namespace
+
+DocxConverter::ImportLimits DocxConverter::importLimits() {
+    QMutexLocker lock(&limitsMutex);
+    return currentLimits;
+}
+
+void DocxConverter::setImportLimits(const ImportLimits &limits) {
+    QMutexLocker lock(&limitsMutex);
+    currentLimits = limits;
+}
+
+bool DocxConverter::importDocx(const QString &filePath, QString &htmlOut,
+                               QHash<QString, QByteArray> &imagesOut,
+                               QString *errorOut) {
+    htmlOut.clear();
+    imagesOut.clear();
+
+    MappedPackage package;
+    mz_zip_archive zip;
+    mz_uint documentIndex = 0;
+    QHash<QString, QString> rels;
+    QStringList imageTargets;
+    const ImportLimits limits = importLimits();
+    if (!openPackage(filePath, package, zip, documentIndex, rels,
+                     imageTargets, limits, errorOut))
+        return false;
+
+    QString html;
+    bool ok;
+    {
+        QThreadPool pool;
+        MediaLoader media(package, imageTargets, limits.maxImagePixels,
+                          &pool);
+        ZipEntryReader documentXml(&zip, documentIndex);
+        HtmlSink sink(html, imagesOut);
+        ok = documentXml.isOpen() &&
+             walkDocument(documentXml, rels, media, sink, limits, errorOut);
+        if (ok) sink.finish();
+        else if (!documentXml.isOpen() && errorOut)
+            *errorOut = QStringLiteral("Cannot read document.xml.");
+    }
+    mz_zip_reader_end(&zip);
+    if (!ok) return false;
 
-    html += "</body></html>";
     htmlOut = html;
     return true;
 }
+
+bool DocxConverter::importDocx(const QString &filePath, QTextDocument *doc,
+                               QString *errorOut,
+                               const ImportProgressCallback &progress,
+                               const std::atomic<bool> *cancel) {
+    MappedPackage package;
+    mz_zip_archive zip;
+    mz_uint documentIndex = 0;
+    QHash<QString, QString> rels;
+    QStringList imageTargets;
+    const ImportLimits limits = importLimits();
+    if (!openPackage(filePath, package, zip, documentIndex, rels,
+                     imageTargets, limits, errorOut))
+        return false;
+
+    bool ok;
+    {
+        // Pictures are read on the pool from the start, alongside the walk
+        QThreadPool pool;
+        MediaLoader media(package, imageTargets, limits.maxImagePixels,
+                          &pool);
+        ZipEntryReader documentXml(&zip, documentIndex);
+        if (!documentXml.isOpen()) {
+            if (errorOut)
+                *errorOut = QStringLiteral("Cannot read document.xml.");
+            ok = false;
+        } else {
+            QElapsedTimer timer;
+            timer.start();
+
+            // Nothing for undo to keep; turning it off also empties the stack
+            const bool undo = doc->isUndoRedoEnabled();
+            doc->setUndoRedoEnabled(false);
+            doc->clear();
+
+            DocumentSink sink(doc);
+            ok = walkDocument(documentXml, rels, media, sink, limits,
+                              errorOut, progress, cancel);
+            sink.finish();
+
+            doc->setUndoRedoEnabled(undo);
+            doc->setModified(false);
+            // qDebug() << "importDocx (direct) took:" << timer.elapsed() << "ms";
+        }
+    }
+    mz_zip_reader_end(&zip);
+    return ok;
+}
@@ -4,6 +4,8 @@
 #include <QString>
 #include <QByteArray>
 #include <QHash>
+#include <atomic>
+#include <functional>
 
 class QTextDocument;
 
@@ -31,6 +33,45 @@ bool importDocx(const QString &filePath, QString &htmlOut,
                 QHash<QString, QByteArray> &imagesOut,
                 QString *errorOut = nullptr);
 
+// Bounds on what an import takes on, against files built (or broken) to
+// exhaust memory: zip bombs, enormous pictures. They're checked from sizes
+// the package and image headers declare, before anything is allocated for
+// them, and a file over any of them fails to import with an error saying
+// which.
+struct ImportLimits {
+    qint64 maxTotalBytes = qint64(1) << 30;  // every entry, uncompressed
+    int maxRatio = 100;             // uncompressed : compressed, per entry
+                                    // (entries of 1 MB or less are exempt)
+    qint64 maxImagePixels = 200 * 1000 * 1000;
+    int maxParagraphs = 5000000;
+};
+
+// The limits every import uses. Safe to call from any thread.
+ImportLimits importLimits();
+void setImportLimits(const ImportLimits &limits);
+
+// How far an import has got
+struct ImportProgress {
+    qint64 bytesInflated = 0; // of word/document.xml
+    qint64 bytesTotal = 0;    // its full size
+    int paragraphs = 0;       // parsed so far
+};
+using ImportProgressCallback = std::function<void(const ImportProgress &)>;
+
+// Import the .docx at `filePath` straight into `doc`, replacing its
+// contents and undo history, with no HTML in between: faster than the
+// overload above followed by setHtml(), and lighter on memory. `doc` is
+// left alone if the file isn't a readable .docx; if document.xml turns
+// out to be malformed part-way, it holds what came before the error.
+//
+// `progress` is called on the importing thread after every piece of
+// document.xml. Setting `*cancel` (from any thread) stops the import soon
+// after, as a failure, with `doc` holding what was read until then.
+bool importDocx(const QString &filePath, QTextDocument *doc,
+                QString *errorOut = nullptr,
+                const ImportProgressCallback &progress = {},
+                const std::atomic<bool> *cancel = nullptr);
+
 } // namespace DocxConverter
 
 #endif // DOCXCONVERTER_H
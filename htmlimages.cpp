@@ -0,0 +1,118 @@
+#include "htmlimages.h"
+#include "imageingest.h"
+#include "imagestore.h"
+
+#include <QTextDocument>
+#include <QRegularExpression>
+#include <QList>
+#include <QDebug>
+
+QString HtmlImages::extractDataUris(QString html, int &counter,
+                                   QHash<QString, QByteArray> &imagesOut) {
+    // ----------------------------------------------------------------
+    // Qt's setHtml() does NOT support data: URIs in <img> src
+    // attributes — it renders the raw URI as text instead of an
+    // image. We therefore:
+    //   1. Find every data URI in the HTML.
+    //   2. Replace it with a plain "myimage/..." resource name.
+    //   3. Decode the base64 bytes and keep them in `imagesOut`.
+    // ----------------------------------------------------------------
+    // Matches:  src="data:image/png;base64,<base64data>"
+    //   cap(1) = format extension ("png", "jpg", …)
+    //   cap(2) = raw base64 string
+    static const QRegularExpression dataUriRx(
+        "src=\"data:image/([a-zA-Z]+);base64,([^\"]+)\"",
+        QRegularExpression::DotMatchesEverythingOption);
+
+    static const QRegularExpression widthRx("\\bwidth\\s*=\\s*\"?(\\d+)");
+
+    QRegularExpressionMatchIterator it = dataUriRx.globalMatch(html);
+    QList<QRegularExpressionMatch> matches;
+    while (it.hasNext())
+        matches.append(it.next());
+
+    // Process in reverse so earlier replacements don't shift later offsets
+    for (int idx = matches.size() - 1; idx >= 0; --idx) {
+        const auto &match = matches[idx];
+        QString fmt  = match.captured(1);               // e.g. "png"
+        QString b64  = match.captured(2);               // raw base64
+
+        // Bring oversized embedded pictures down to the width their <img>
+        // tag displays them at; anything already small enough is kept as-is
+        // and not decoded here at all.
+        int displayWidth = 0;
+        const int tagStart = html.lastIndexOf(QLatin1String("<img"), match.capturedStart());
+        const int tagEnd = html.indexOf(QLatin1Char('>'), match.capturedEnd());
+        if (tagStart >= 0 && tagEnd > tagStart) {
+            const QRegularExpressionMatch w = widthRx.match(
+                html.mid(tagStart, tagEnd - tagStart));
+            if (w.hasMatch()) displayWidth = w.captured(1).toInt();
+        }
+
+        const QByteArray raw = QByteArray::fromBase64(b64.toLatin1());
+        QByteArray format;
+        QByteArray ba = ImageIngest::ingest(raw, displayWidth, &format);
+        if (ba.isEmpty()) {
+            // Unreadable here; keep it verbatim rather than lose it
+            ba = raw;
+        } else {
+            fmt = ImageIngest::suffixFor(format);
+        }
+
+        QString resourceName =
+            QString("myimage/loaded_%1.%2").arg(counter++).arg(fmt);
+        imagesOut[resourceName] = ba;
+
+        // Replace  src="data:image/png;base64,…"  with  src="myimage/loaded_N.png"
+        html.replace(match.capturedStart(), match.capturedLength(),
+                     QString("src=\"%1\"").arg(resourceName));
+    }
+    return html;
+}
+
+QString HtmlImages::embedDataUris(QString html, const QTextDocument *doc) {
+    // ----------------------------------------------------------------
+    // Embed every internal image resource as a base64 data URI so the
+    // file is self-contained and images survive a save/reload cycle.
+    //
+    // Two bugs fixed vs. the original code:
+    //
+    //  1. Qt may internally decode a stored QByteArray resource into a
+    //     QImage for rendering, losing the original container.  The
+    //     encoded bytes are read back from ImageStore instead, which
+    //     keeps them untouched, and labelled with their real MIME type.
+    //
+    //  2. The original code iterated matches *forwards* and then called
+    //     html.replace(offset, len, newText).  Once the first replacement
+    //     changes the string length every subsequent stored offset is
+    //     wrong.  We collect all matches first, then process them in
+    //     *reverse* order so earlier replacements don't shift later ones.
+    // ----------------------------------------------------------------
+    static const QRegularExpression imgRx(
+        "<img\\s+[^>]*src\\s*=\\s*\"(myimage/[^\"]+)\"[^>]*>");
+
+    QRegularExpressionMatchIterator it = imgRx.globalMatch(html);
+    QList<QRegularExpressionMatch> matches;
+    while (it.hasNext())
+        matches.append(it.next());
+
+    for (int idx = matches.size() - 1; idx >= 0; --idx) {
+        const auto &match = matches[idx];
+        QString resourceName = match.captured(1);
+
+        const QByteArray ba = ImageStore::bytes(doc, resourceName);
+        if (ba.isEmpty()) {
+            qDebug() << "embedDataUris: resource not found or unknown type:" << resourceName;
+            continue;
+        }
+
+        QString base64  = QString::fromLatin1(ba.toBase64());
+        QString dataUrl = "data:" + ImageIngest::mimeTypeOf(ba) + ";base64," + base64;
+
+        // Splice the data URI into the tag in-place
+        QString newTag = match.captured();
+        newTag.replace(resourceName, dataUrl);
+        html.replace(match.capturedStart(), match.capturedLength(), newTag);
+    }
+    return html;
+}
@@ -0,0 +1,31 @@
+#ifndef HTMLIMAGES_H
+#define HTMLIMAGES_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+
+class QTextDocument;
+
+// Translation between the HTML MattWord saves (pictures embedded as
+// base64 data: URIs, so a file is self-contained) and the HTML
+// QTextDocument works with (pictures referenced as "myimage/..." document
+// resources). Shared by the editor and the mattword-convert tool.
+namespace HtmlImages {
+
+// Replace every data: URI image in `html` with a "myimage/loaded_N.ext"
+// resource name and put its bytes in `imagesOut`, brought within the
+// width its <img> tag displays it at (see ImageIngest::ingest).
+// `counter` numbers the names and carries over between calls, so a
+// document can be processed a piece at a time. Register the images on
+// the document after setHtml().
+QString extractDataUris(QString html, int &counter,
+                        QHash<QString, QByteArray> &imagesOut);
+
+// The reverse: every src="myimage/..." in `html` becomes a data: URI
+// holding that image's encoded bytes from `doc` (see ImageStore).
+QString embedDataUris(QString html, const QTextDocument *doc);
+
+} // namespace HtmlImages
+
+#endif // HTMLIMAGES_H
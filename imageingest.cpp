@@ -0,0 +1,208 @@
+#include "imageingest.h"
+
+#include <QImageReader>
+#include <QImageIOHandler>
+#include <QBuffer>
+#include <QFile>
+#include <QtMath>
+
+namespace {
+
+// QImageReader::size() reports the stored orientation; a portrait photo
+// with an EXIF "rotate 90" tag is shown transposed.
+bool isRotated(QImageReader &reader) {
+    return reader.transformation().testFlag(
+        QImageIOHandler::TransformationRotate90);
+}
+
+QSize displayedSize(QImageReader &reader) {
+    const QSize stored = reader.size();
+    if (!stored.isValid()) return {};
+    return isRotated(reader) ? stored.transposed() : stored;
+}
+
+// Fallback for codecs without native scaled decoding. A single smooth
+// pass over a huge bitmap is the slow part, so big reductions first drop
+// to twice the target with a cheap nearest-neighbour pass and only then
+// filter.
+QImage shrink(const QImage &image, const QSize &target) {
+    QImage img = image;
+    if (img.width() >= target.width() * 4 &&
+        img.height() >= target.height() * 4) {
+        img = img.scaled(target * 2, Qt::IgnoreAspectRatio,
+                         Qt::FastTransformation);
+    }
+    return img.scaled(target, Qt::IgnoreAspectRatio,
+                      Qt::SmoothTransformation);
+}
+
+} // anonymous namespace
+
+QSize ImageIngest::boundedSize(const QSize &intrinsic, int targetWidth) {
+    if (!intrinsic.isValid() || intrinsic.isEmpty()) return intrinsic;
+
+    QSize size = intrinsic;
+    if (targetWidth > 0 && size.width() > targetWidth) {
+        size = QSize(targetWidth,
+                     qMax(1, qRound(qreal(size.height()) * targetWidth /
+                                    size.width())));
+    }
+
+    const qint64 pixels = qint64(size.width()) * size.height();
+    if (pixels > MAX_IMAGE_PIXELS) {
+        const qreal f = qSqrt(qreal(MAX_IMAGE_PIXELS) / qreal(pixels));
+        size = QSize(qMax(1, int(size.width() * f)),
+                     qMax(1, int(size.height() * f)));
+    }
+    return size;
+}
+
+QSize ImageIngest::intrinsicSize(const QByteArray &bytes) {
+    QBuffer buf;
+    buf.setData(bytes);
+    buf.open(QIODevice::ReadOnly);
+    QImageReader reader(&buf);
+    return displayedSize(reader);
+}
+
+QSize ImageIngest::intrinsicSize(const QString &filePath) {
+    QImageReader reader(filePath);
+    return displayedSize(reader);
+}
+
+QImage ImageIngest::decode(QIODevice *device, int targetWidth,
+                           QString *errorOut) {
+    QImageReader reader(device);
+    reader.setAutoTransform(true);
+
+    const QSize shown = displayedSize(reader);
+    if (shown.isValid()) {
+        const QSize want = boundedSize(shown, targetWidth);
+        if (want != shown &&
+            reader.supportsOption(QImageIOHandler::ScaledSize)) {
+            // The scaled size applies before the EXIF transform
+            reader.setScaledSize(isRotated(reader) ? want.transposed()
+                                                   : want);
+        }
+    }
+
+    QImage img = reader.read();
+    if (img.isNull()) {
+        if (errorOut) *errorOut = reader.errorString();
+        return {};
+    }
+
+    const QSize want = boundedSize(img.size(), targetWidth);
+    if (want != img.size()) img = shrink(img, want);
+    return img;
+}
+
+QImage ImageIngest::decodeFile(const QString &filePath, int targetWidth,
+                               QString *errorOut) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorOut) *errorOut = file.errorString();
+        return {};
+    }
+    return decode(&file, targetWidth, errorOut);
+}
+
+QImage ImageIngest::decodeData(const QByteArray &bytes, int targetWidth,
+                               QString *errorOut) {
+    QBuffer buf;
+    buf.setData(bytes);
+    buf.open(QIODevice::ReadOnly);
+    return decode(&buf, targetWidth, errorOut);
+}
+
+QImage ImageIngest::fitToWidth(const QImage &image, int targetWidth) {
+    if (image.isNull()) return image;
+    const QSize want = boundedSize(image.size(), targetWidth);
+    return want == image.size() ? image : shrink(image, want);
+}
+
+QByteArray ImageIngest::formatOf(const QByteArray &bytes) {
+    QBuffer buf;
+    buf.setData(bytes);
+    buf.open(QIODevice::ReadOnly);
+    return QImageReader::imageFormat(&buf).toLower();
+}
+
+QString ImageIngest::mimeTypeOf(const QByteArray &bytes) {
+    const QByteArray format = formatOf(bytes);
+    if (format.isEmpty()) return QStringLiteral("image/png");
+    return QStringLiteral("image/") + QString::fromLatin1(format);
+}
+
+QString ImageIngest::suffixFor(const QByteArray &format) {
+    if (format == "jpeg") return QStringLiteral("jpg");
+    if (format.isEmpty()) return QStringLiteral("png");
+    return QString::fromLatin1(format);
+}
+
+bool ImageIngest::isPassthroughFormat(const QByteArray &format) {
+    return format == "jpeg" || format == "png" || format == "gif" ||
+           format == "webp";
+}
+
+QByteArray ImageIngest::ingest(const QByteArray &bytes, int targetWidth,
+                               QByteArray *formatOut) {
+    QBuffer buf;
+    buf.setData(bytes);
+    buf.open(QIODevice::ReadOnly);
+    QImageReader reader(&buf);
+    const QByteArray format = reader.format().toLower();
+    const QSize shown = displayedSize(reader);
+    if (format.isEmpty() || !shown.isValid()) return {};
+
+    // EXIF-rotated photos are baked upright: not every consumer of the
+    // saved file honours the orientation tag
+    if (isPassthroughFormat(format) &&
+        !reader.transformation() &&
+        boundedSize(shown, targetWidth) == shown) {
+        if (formatOut) *formatOut = format;
+        return bytes;
+    }
+
+    const QImage img = decodeData(bytes, targetWidth);
+    if (img.isNull()) return {};
+    const QByteArray outFormat =
+        format == "jpeg" ? QByteArray("jpeg") : QByteArray("png");
+    if (formatOut) *formatOut = outFormat;
+    return encode(img, outFormat);
+}
+
+QByteArray ImageIngest::ingestFile(const QString &filePath, int targetWidth,
+                                   QByteArray *formatOut, QString *errorOut) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorOut) *errorOut = file.errorString();
+        return {};
+    }
+    const QByteArray out = ingest(file.readAll(), targetWidth, formatOut);
+    if (out.isEmpty() && errorOut)
+        *errorOut = QStringLiteral("Unsupported or damaged image file.");
+    return out;
+}
+
+QByteArray ImageIngest::encode(const QImage &image, const QByteArray &format) {
+    // 3780 dots per meter is what Qt itself writes for 96 dpi; clipboard
+    // and canvas images can otherwise carry the screen's density
+    QImage img = image;
+    img.setDotsPerMeterX(3780);
+    img.setDotsPerMeterY(3780);
+
+    QByteArray ba;
+    QBuffer buffer(&ba);
+    buffer.open(QIODevice::WriteOnly);
+    if (format == "jpeg")
+        img.save(&buffer, "JPEG", 90);
+    else
+        img.save(&buffer, "PNG");
+    buffer.close();
+    return ba;
+}
+
+QByteArray ImageIngest::encodePng(const QImage &image) {
+    return encode(image, "png");
+}
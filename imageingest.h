@@ -0,0 +1,86 @@
+#ifndef IMAGEINGEST_H
+#define IMAGEINGEST_H
+
+#include <QImage>
+#include <QByteArray>
+#include <QString>
+#include <QSize>
+
+class QIODevice;
+
+// Single entry point for every way a picture gets into a document:
+// Insert ▸ Image, clipboard paste, .docx import and HTML open.
+//
+// Images are decoded straight at (or near) the size they'll be shown at.
+// Codecs that can do it natively (JPEG's DCT scaling) are asked to via
+// QImageReader::setScaledSize, so a 48 MP phone photo never exists as a
+// full-resolution 200 MB bitmap; everything else is downscaled right
+// after decoding. Independently of the display width, no image is ever
+// kept above MAX_IMAGE_PIXELS.
+namespace ImageIngest {
+
+// Hard cap on decoded pixels for any one image: 8 MP is ~32 MB as
+// ARGB32, which keeps a single picture well inside the editor's ~100 MB
+// working-set budget.
+constexpr qint64 MAX_IMAGE_PIXELS = 8 * 1024 * 1024;
+
+// Size the decoded bitmap should have: at most `targetWidth` wide
+// (0 = no width limit), aspect kept, and within MAX_IMAGE_PIXELS.
+QSize boundedSize(const QSize &intrinsic, int targetWidth);
+
+// Header-only probe of the displayed size (EXIF rotation applied).
+// Returns an invalid size if the data isn't a readable image.
+QSize intrinsicSize(const QByteArray &bytes);
+QSize intrinsicSize(const QString &filePath);
+
+// Decode at boundedSize(). On failure returns a null image and, if
+// given, sets *errorOut.
+QImage decode(QIODevice *device, int targetWidth, QString *errorOut = nullptr);
+QImage decodeFile(const QString &filePath, int targetWidth,
+                  QString *errorOut = nullptr);
+QImage decodeData(const QByteArray &bytes, int targetWidth,
+                  QString *errorOut = nullptr);
+
+// Bring an already-decoded image (clipboard, drawing canvas) within the
+// same bounds.
+QImage fitToWidth(const QImage &image, int targetWidth);
+
+// ─── Encoded containers ────────────────────────────────────────────────────
+//
+// Pictures are stored in their original container (JPEG stays JPEG) so
+// photos aren't bloated 3–10× by a PNG re-encode and saving doesn't pay
+// for a deflate of every image.
+
+// Container of `bytes` as Qt names it ("jpeg", "png", "gif", "webp", ...),
+// or empty if unreadable. Content-sniffed, never decodes pixels.
+QByteArray formatOf(const QByteArray &bytes);
+
+// "image/jpeg" etc. for a data URI or package part; image/png if unknown.
+QString mimeTypeOf(const QByteArray &bytes);
+
+// File suffix for a container name: "jpg", "png", ...
+QString suffixFor(const QByteArray &format);
+
+// Containers that are kept byte-for-byte when no resize is needed.
+// Anything else (BMP, TIFF, ...) is re-encoded.
+bool isPassthroughFormat(const QByteArray &format);
+
+// Bring encoded bytes within bounds. Bytes in a passthrough container that
+// already fit are returned untouched without being decoded at all; others
+// are decoded at the reduced size and re-encoded — as JPEG when they came
+// in as JPEG, as PNG otherwise. *formatOut receives the resulting
+// container. Returns empty bytes if the data isn't a readable image.
+QByteArray ingest(const QByteArray &bytes, int targetWidth,
+                  QByteArray *formatOut = nullptr);
+QByteArray ingestFile(const QString &filePath, int targetWidth,
+                      QByteArray *formatOut = nullptr,
+                      QString *errorOut = nullptr);
+
+// Encode `image` in `format` ("jpeg" or "png"), declaring ~96 dpi so the
+// .docx exporter can pass the bytes through unchanged.
+QByteArray encode(const QImage &image, const QByteArray &format);
+QByteArray encodePng(const QImage &image);
+
+} // namespace ImageIngest
+
+#endif // IMAGEINGEST_H
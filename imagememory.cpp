@@ -0,0 +1,85 @@
+#include "imagememory.h"
+
+namespace {
+
+qint64 pixmapBytes(const QPixmap &pm) {
+    return qint64(pm.width()) * pm.height() * qMax(1, pm.depth() / 8);
+}
+
+} // anonymous namespace
+
+ImageMemoryManager::ImageMemoryManager(qint64 budgetBytes)
+    : budgetBytes(budgetBytes) {}
+
+void ImageMemoryManager::setBudget(qint64 bytes) {
+    budgetBytes = qMax<qint64>(0, bytes);
+    evictToBudget();
+}
+
+const QPixmap *ImageMemoryManager::find(const QString &key) {
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        ++misses;
+        return nullptr;
+    }
+    ++hits;
+    lru.splice(lru.begin(), lru, it->lruPos);
+    return &it->pixmap;
+}
+
+void ImageMemoryManager::insert(const QString &key, const QPixmap &pixmap) {
+    auto old = entries.find(key);
+    if (old != entries.end()) {
+        usedBytes -= old->cost;
+        lru.erase(old->lruPos);
+        entries.erase(old);
+    }
+
+    lru.push_front(key);
+    Entry e{pixmap, pixmapBytes(pixmap), lru.begin()};
+    usedBytes += e.cost;
+    entries.insert(key, e);
+    peakBytes = qMax(peakBytes, usedBytes);
+
+    evictToBudget();
+}
+
+void ImageMemoryManager::evictToBudget() {
+    while (usedBytes > budgetBytes && entries.size() > 1) {
+        auto victim = entries.find(lru.back());
+        lru.pop_back();
+        usedBytes -= victim->cost;
+        entries.erase(victim);
+        ++evictions;
+    }
+}
+
+void ImageMemoryManager::removeStartingWith(const QString &prefix) {
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it.key().startsWith(prefix)) {
+            usedBytes -= it->cost;
+            lru.erase(it->lruPos);
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ImageMemoryManager::clear() {
+    entries.clear();
+    lru.clear();
+    usedBytes = 0;
+}
+
+ImageMemoryManager::Stats ImageMemoryManager::stats() const {
+    Stats s;
+    s.budgetBytes = budgetBytes;
+    s.usedBytes = usedBytes;
+    s.peakBytes = peakBytes;
+    s.images = int(entries.size());
+    s.hits = hits;
+    s.misses = misses;
+    s.evictions = evictions;
+    return s;
+}
@@ -0,0 +1,72 @@
+#ifndef IMAGEMEMORY_H
+#define IMAGEMEMORY_H
+
+#include <QString>
+#include <QHash>
+#include <QPixmap>
+#include <list>
+
+// Memory budget for decoded inline images.
+//
+// Only the display pixmaps count against it — a picture's compressed bytes
+// stay on the document as a resource regardless. When the budget is
+// exceeded the least recently painted pixmaps (i.e. those scrolled out of
+// view longest ago) are dropped; they're re-decoded from the compressed
+// bytes if they come back into view.
+class ImageMemoryManager {
+public:
+    static constexpr qint64 DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+    struct Stats {
+        qint64 budgetBytes = 0;
+        qint64 usedBytes = 0;
+        qint64 peakBytes = 0;
+        int images = 0;        // pixmaps currently resident
+        quint64 hits = 0;      // paints served from memory
+        quint64 misses = 0;    // paints that found no pixmap
+        quint64 evictions = 0; // pixmaps dropped to stay in budget
+    };
+
+    explicit ImageMemoryManager(qint64 budgetBytes = DEFAULT_BUDGET);
+
+    // Shrinking the budget evicts immediately.
+    void setBudget(qint64 bytes);
+    qint64 budget() const { return budgetBytes; }
+
+    // The pixmap cached under `key`, marked as most recently used, or
+    // nullptr. The pointer is valid until the next insert() or clear().
+    const QPixmap *find(const QString &key);
+
+    // Cache `pixmap`, then evict least recently used entries until back
+    // within budget. The newest entry itself is never evicted, so a single
+    // picture larger than the whole budget can still be shown.
+    void insert(const QString &key, const QPixmap &pixmap);
+
+    // Drop every entry whose key starts with `prefix`.
+    void removeStartingWith(const QString &prefix);
+
+    void clear();
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        QPixmap pixmap;
+        qint64 cost;
+        std::list<QString>::iterator lruPos;
+    };
+
+    void evictToBudget();
+
+    qint64 budgetBytes;
+    qint64 usedBytes = 0;
+    qint64 peakBytes = 0;
+    quint64 hits = 0;
+    quint64 misses = 0;
+    quint64 evictions = 0;
+
+    QHash<QString, Entry> entries;
+    std::list<QString> lru; // front = most recently painted
+};
+
+#endif // IMAGEMEMORY_H
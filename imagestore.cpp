@@ -0,0 +1,43 @@
+#include "imagestore.h"
+#include "imageingest.h"
+
+#include <QTextDocument>
+#include <QImage>
+#include <QUrl>
+#include <QVariant>
+
+namespace {
+
+// QTextDocument keys resources by URL alone (the type argument is
+// ignored), so the encoded copy needs a URL of its own
+QUrl encodedUrl(const QString &name) {
+    return QUrl(QStringLiteral("mattword-encoded:") + name);
+}
+
+} // anonymous namespace
+
+void ImageStore::add(QTextDocument *doc, const QString &name,
+                     const QByteArray &bytes) {
+    // Implicitly shared: both entries point at the same buffer
+    doc->addResource(QTextDocument::ImageResource, QUrl(name), bytes);
+    doc->addResource(QTextDocument::UserResource, encodedUrl(name), bytes);
+}
+
+QByteArray ImageStore::bytes(const QTextDocument *doc, const QString &name) {
+    const QVariant encoded =
+        doc->resource(QTextDocument::UserResource, encodedUrl(name));
+    if (encoded.typeId() == QMetaType::QByteArray)
+        return encoded.toByteArray();
+
+    // Registered by someone other than add() (e.g. setHtml on a document
+    // with external images)
+    const QVariant res =
+        doc->resource(QTextDocument::ImageResource, QUrl(name));
+    if (res.typeId() == QMetaType::QByteArray)
+        return res.toByteArray();
+    if (res.canConvert<QImage>()) {
+        const QImage img = res.value<QImage>();
+        if (!img.isNull()) return ImageIngest::encodePng(img);
+    }
+    return {};
+}
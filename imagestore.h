@@ -0,0 +1,30 @@
+#ifndef IMAGESTORE_H
+#define IMAGESTORE_H
+
+#include <QString>
+#include <QByteArray>
+
+class QTextDocument;
+
+// Keeps every picture's original encoded bytes on the document itself.
+//
+// Qt's own image handler swaps an image resource's QByteArray for the
+// decoded QImage the first time it paints it, after which the original
+// container (and the fact that it was a JPEG) is gone. The encoded bytes
+// are therefore also registered under a private companion URL that no
+// image format ever references, so Qt never touches them; save and export
+// read them back from there. Being ordinary document resources they follow
+// clone() (printing) and are dropped by clear() like everything else.
+namespace ImageStore {
+
+// Register `bytes` as image `name` (a "myimage/..." resource name).
+void add(QTextDocument *doc, const QString &name, const QByteArray &bytes);
+
+// The encoded bytes of image `name`: the original container when known,
+// otherwise a PNG encode of whatever Qt holds. Empty if there's no such
+// image.
+QByteArray bytes(const QTextDocument *doc, const QString &name);
+
+} // namespace ImageStore
+
+#endif // IMAGESTORE_H
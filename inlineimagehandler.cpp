@@ -0,0 +1,179 @@
+#include "inlineimagehandler.h"
+#include "imageingest.h"
+
+#include <QTextDocument>
+#include <QAbstractTextDocumentLayout>
+#include <QTextImageFormat>
+#include <QPainter>
+#include <QPaintDevice>
+#include <QImage>
+#include <QUrl>
+#include <QVariant>
+#include <QRunnable>
+#include <QThread>
+#include <QColor>
+#include <QMetaObject>
+
+#include <utility>
+
+namespace {
+
+QString cacheKey(const QString &name, const QSize &devicePixels) {
+    return QStringLiteral("%1|%2x%3")
+        .arg(name)
+        .arg(devicePixels.width())
+        .arg(devicePixels.height());
+}
+
+} // anonymous namespace
+
+InlineImageHandler::InlineImageHandler(QObject *parent)
+    : QObject(parent) {
+    // Leave a core free for the UI thread
+    decoder.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+InlineImageHandler::~InlineImageHandler() {
+    // Workers post their results back to this object
+    decoder.clear();
+    decoder.waitForDone();
+}
+
+void InlineImageHandler::install(QTextDocument *doc) {
+    if (doc && doc->documentLayout())
+        doc->documentLayout()->registerHandler(QTextFormat::ImageObject, this);
+}
+
+void InlineImageHandler::clear() {
+    pixmaps.clear();
+    naturalSizes.clear();
+    pending.clear();
+    failed.clear();
+    decoder.clear(); // queued, not yet started
+    ++generation;    // results of running decodes are dropped on arrival
+}
+
+void InlineImageHandler::forget(const QString &name) {
+    // Every cacheKey() of `name`
+    const QString prefix = name + QLatin1Char('|');
+    pixmaps.removeStartingWith(prefix);
+    naturalSizes.remove(name);
+    failed.removeIf([&prefix](const QString &key) { return key.startsWith(prefix); });
+
+    // A decode already running may be of the old bytes. Drop every result
+    // still to come and ask for the placeholders to be painted again,
+    // which queues them afresh.
+    ++generation;
+    const auto waiting = std::exchange(pending, {});
+    for (const QList<QRectF> &rects : waiting)
+        for (const QRectF &r : rects)
+            emit imageReady(r);
+}
+
+QSize InlineImageHandler::naturalSize(QTextDocument *doc,
+                                      const QString &name) {
+    auto it = naturalSizes.constFind(name);
+    if (it != naturalSizes.constEnd()) return it.value();
+
+    QSize size;
+    const QVariant res =
+        doc->resource(QTextDocument::ImageResource, QUrl(name));
+    if (res.typeId() == QMetaType::QByteArray)
+        size = ImageIngest::intrinsicSize(res.toByteArray()); // header only
+    else if (res.canConvert<QImage>())
+        size = res.value<QImage>().size();
+
+    // Unreadable pictures are remembered too, so they're not re-probed
+    // on every layout pass
+    naturalSizes.insert(name, size);
+    return size;
+}
+
+QSizeF InlineImageHandler::intrinsicSize(QTextDocument *doc, int,
+                                         const QTextFormat &format) {
+    // Same rules as Qt's own handler: an explicit width and height win;
+    // with only one of them the other follows the picture's aspect ratio
+    const QTextImageFormat imgFmt = format.toImageFormat();
+    const bool hasWidth = imgFmt.hasProperty(QTextFormat::ImageWidth);
+    const bool hasHeight = imgFmt.hasProperty(QTextFormat::ImageHeight);
+    if (hasWidth && hasHeight)
+        return QSizeF(imgFmt.width(), imgFmt.height());
+
+    QSize natural = naturalSize(doc, imgFmt.name());
+    if (!natural.isValid() || natural.isEmpty()) natural = QSize(16, 16);
+
+    if (hasWidth) {
+        return QSizeF(imgFmt.width(),
+                      imgFmt.width() * natural.height() / natural.width());
+    }
+    if (hasHeight) {
+        return QSizeF(imgFmt.height() * natural.width() / natural.height(),
+                      imgFmt.height());
+    }
+    return QSizeF(natural);
+}
+
+void InlineImageHandler::decoded(const QString &key, const QImage &image,
+                                 qreal dpr, int forGeneration) {
+    if (forGeneration != generation) return; // document was replaced
+
+    const QList<QRectF> rects = pending.take(key);
+    if (image.isNull()) {
+        failed.insert(key);
+    } else {
+        QPixmap pm = QPixmap::fromImage(image);
+        pm.setDevicePixelRatio(dpr);
+        pixmaps.insert(key, pm);
+    }
+    for (const QRectF &r : rects)
+        emit imageReady(r);
+}
+
+void InlineImageHandler::drawObject(QPainter *painter, const QRectF &rect,
+                                    QTextDocument *doc, int,
+                                    const QTextFormat &format) {
+    const QString name = format.toImageFormat().name();
+    const qreal dpr = painter->device()->devicePixelRatio();
+    const QSize devicePixels = (rect.size() * dpr).toSize();
+    if (devicePixels.isEmpty()) return;
+
+    const QString key = cacheKey(name, devicePixels);
+    if (const QPixmap *pm = pixmaps.find(key)) {
+        painter->drawPixmap(rect.topLeft(), *pm);
+        return;
+    }
+    if (failed.contains(key)) return;
+
+    // Placeholder until the worker delivers; light enough for either theme
+    painter->save();
+    painter->setPen(QColor(128, 128, 128, 90));
+    painter->setBrush(QColor(128, 128, 128, 40));
+    painter->drawRect(rect.adjusted(0.5, 0.5, -0.5, -0.5));
+    painter->restore();
+
+    QList<QRectF> &rects = pending[key];
+    const bool alreadyQueued = !rects.isEmpty();
+    if (!rects.contains(rect)) rects.append(rect);
+    if (alreadyQueued) return;
+
+    const QVariant res =
+        doc->resource(QTextDocument::ImageResource, QUrl(name));
+    const int gen = generation;
+    decoder.start(QRunnable::create([this, res, key, devicePixels, dpr, gen]() {
+        QImage img;
+        if (res.typeId() == QMetaType::QByteArray) {
+            // Scaled decode: a big photo never exists at full resolution
+            img = ImageIngest::decodeData(res.toByteArray(),
+                                          devicePixels.width());
+        } else if (res.canConvert<QImage>()) {
+            img = res.value<QImage>();
+        }
+        if (!img.isNull() && img.size() != devicePixels) {
+            img = img.scaled(devicePixels, Qt::IgnoreAspectRatio,
+                             Qt::SmoothTransformation);
+        }
+        QMetaObject::invokeMethod(this, [this, key, img, dpr, gen]() {
+            decoded(key, img, dpr, gen);
+        }, Qt::QueuedConnection);
+    }));
+}
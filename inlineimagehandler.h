@@ -0,0 +1,85 @@
+#ifndef INLINEIMAGEHANDLER_H
+#define INLINEIMAGEHANDLER_H
+
+#include <QObject>
+#include <QTextObjectInterface>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QPixmap>
+#include <QImage>
+#include <QRectF>
+#include <QSize>
+#include <QThreadPool>
+#include "imagememory.h"
+
+class QTextDocument;
+
+// Renders inline images for the editor in place of Qt's built-in image
+// handler.
+//
+// Qt's handler keeps each picture at its stored resolution and rescales it
+// to the QTextImageFormat width on every paint, so scrolling through an
+// image-heavy document repeats a smooth scale per image per frame. This
+// handler keeps a pixmap already scaled to the displayed size (in device
+// pixels, so HiDPI screens stay sharp) per (resource, size) pair within a
+// memory budget (see ImageMemoryManager); painting an image that's on
+// screen again is a plain blit.
+//
+// Pictures are never decoded on the UI thread. Layout sizes come from the
+// format or a header-only probe, so nothing moves when pixels arrive; a
+// missing pixmap is decoded on a worker pool while a light placeholder is
+// painted in its place, and imageReady() then asks for just that
+// rectangle to be repainted.
+//
+// Registered on the editor's document layout only. Printing works on a
+// clone of the document, which gets Qt's own handler and full-resolution
+// output.
+class InlineImageHandler : public QObject, public QTextObjectInterface {
+    Q_OBJECT
+    Q_INTERFACES(QTextObjectInterface)
+
+public:
+    explicit InlineImageHandler(QObject *parent = nullptr);
+    ~InlineImageHandler() override;
+
+    // (Re)register this handler for QTextFormat::ImageObject on `doc`'s
+    // current layout. Must be repeated when the layout is replaced.
+    void install(QTextDocument *doc);
+
+    // Forget cached pixmaps and sizes, e.g. when a new file reuses the
+    // same resource names for different pictures.
+    void clear();
+
+    // Forget what's cached for resource `name` alone, when the document's
+    // bytes under that name have been replaced.
+    void forget(const QString &name);
+
+    // Budget, usage and eviction counters for the display pixmaps.
+    ImageMemoryManager &memory() { return pixmaps; }
+
+    QSizeF intrinsicSize(QTextDocument *doc, int posInDocument,
+                         const QTextFormat &format) override;
+    void drawObject(QPainter *painter, const QRectF &rect,
+                    QTextDocument *doc, int posInDocument,
+                    const QTextFormat &format) override;
+
+signals:
+    // Pixels for an image painted as a placeholder have arrived; `rect` is
+    // where it was drawn, in document coordinates.
+    void imageReady(const QRectF &rect);
+
+private:
+    QSize naturalSize(QTextDocument *doc, const QString &name);
+    void decoded(const QString &key, const QImage &image, qreal dpr,
+                 int forGeneration);
+
+    ImageMemoryManager pixmaps;         // "name|WxH" -> display pixmap
+    QHash<QString, QSize> naturalSizes; // header probes, per resource
+    QHash<QString, QList<QRectF>> pending; // key -> placeholder rects
+    QSet<QString> failed;               // keys that can't be decoded
+    int generation = 0;                 // bumped by clear()
+    QThreadPool decoder;
+};
+
+#endif // INLINEIMAGEHANDLER_H
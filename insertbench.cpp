@@ -0,0 +1,114 @@
+// insertbench.cpp — mattword-insertbench: times inserting an image into
+// documents of growing length, to check the cost stays flat.
+//
+// Follows MainWindow::insertImageResource(): the image is inserted through
+// a cursor with the document's signals blocked (as BulkEdit does), then
+// markContentsDirty() covers just the inserted block. For comparison the
+// same insert is also timed with the whole document marked dirty, which is
+// what the editor used to do. Spell-check rehighlighting is left out; it
+// needs the editor widget, and BulkEdit limits it to the same block.
+#include "imagestore.h"
+#include "imageingest.h"
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QTextDocument>
+#include <QAbstractTextDocumentLayout>
+#include <QTextCursor>
+#include <QTextBlock>
+#include <QTextImageFormat>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QColor>
+#include <QList>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+// A document of `blocks` paragraphs of ordinary prose, laid out at page
+// width
+void fill(QTextDocument &doc, int blocks) {
+    const QString text = QStringLiteral(
+        "The quick brown fox jumps over the lazy dog, and then it runs "
+        "back again to see whether the dog has noticed anything at all.");
+    doc.setTextWidth(700);
+    QTextCursor cursor(&doc);
+    cursor.beginEditBlock();
+    for (int i = 0; i < blocks; ++i) {
+        if (i) cursor.insertBlock();
+        cursor.insertText(text);
+    }
+    cursor.endEditBlock();
+    doc.documentLayout()->documentSize(); // lay it all out now
+}
+
+// Milliseconds to insert `name` in the middle of the document and lay
+// the document out again
+double insertImage(QTextDocument &doc, const QString &name,
+                   const QByteArray &png, bool wholeDocument) {
+    QElapsedTimer timer;
+    timer.start();
+
+    QTextCursor cursor(doc.findBlockByNumber(doc.blockCount() / 2));
+    doc.blockSignals(true);
+    ImageStore::add(&doc, name, png);
+    QTextImageFormat imageFormat;
+    imageFormat.setName(name);
+    imageFormat.setWidth(300);
+    cursor.insertImage(imageFormat);
+    doc.blockSignals(false);
+
+    if (wholeDocument) {
+        doc.markContentsDirty(0, doc.characterCount());
+    } else {
+        const QTextBlock block = cursor.block();
+        doc.markContentsDirty(block.position(), block.length());
+    }
+    doc.documentLayout()->documentSize();
+    return timer.nsecsElapsed() / 1e6;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[]) {
+    // Fonts and images need a QGuiApplication, but not a display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName("mattword-insertbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Time image insertion against document length.");
+    parser.addHelpOption();
+    const QCommandLineOption repeatOpt(
+        QStringList() << "r" << "repeat", "Inserts timed per size (default: 5).",
+        "N", "5");
+    parser.addOption(repeatOpt);
+    parser.process(app);
+    const int repeat = qMax(1, parser.value(repeatOpt).toInt());
+
+    QImage image(800, 600, QImage::Format_RGB32);
+    image.fill(QColor(70, 130, 180));
+    const QByteArray png = ImageIngest::encodePng(image);
+
+    std::printf("%8s  %14s  %14s\n", "blocks", "block dirty ms", "whole doc ms");
+    for (const int blocks : {1000, 10000, 100000}) {
+        double times[2];
+        for (int whole = 0; whole < 2; ++whole) {
+            QTextDocument doc;
+            fill(doc, blocks);
+            QList<double> runs;
+            for (int i = 0; i < repeat; ++i)
+                runs.append(insertImage(
+                    doc, QStringLiteral("myimage/bench_%1.png").arg(i), png,
+                    whole));
+            // The median, so one slow run doesn't skew it
+            std::sort(runs.begin(), runs.end());
+            times[whole] = runs.at(runs.size() / 2);
+        }
+        std::printf("%8d  %14.2f  %14.2f\n", blocks, times[0], times[1]);
+    }
+    return 0;
+}
@@ -1,6 +1,11 @@
 #include "mainwindow.h"
 #include "drawingcanvas.h"
 #include "docxconverter.h"
+#include "imageingest.h"
+#include "imagestore.h"
+#include "htmlimages.h"
+#include "conversion.h"
+#include "compressionpolicy.h"
 #include <QFile>
 #include <QTextStream>
 #include <QDir>
@@ -18,6 +23,13 @@
 #include <QInputDialog>
 #include <QKeyEvent>
 #include <QVariant>
+#include <QScrollBar>
+#include <QSettings>
+#include <QPushButton>
+#include <QStatusBar>
+#include <QTextDocumentFragment>
+#include <QActionGroup>
+#include <atomic>
 
 MyTextEdit::MyTextEdit(QWidget *parent) : QTextEdit(parent) {
     setAcceptRichText(true);
@@ -35,6 +47,12 @@ void MyTextEdit::paintEvent(QPaintEvent *event) {
     // qDebug() << "paintEvent took:" << timer.elapsed() << "ms";
 }
 
+void MyTextEdit::updateDocumentRect(const QRectF &rect) {
+    viewport()->update(rect.translated(-horizontalScrollBar()->value(),
+                                       -verticalScrollBar()->value())
+                           .toAlignedRect());
+}
+
 bool MyTextEdit::viewportEvent(QEvent *event) {
     if (event->type() == QEvent::UpdateRequest) {
         // qDebug() << "Viewport update requested";
@@ -130,12 +148,6 @@ void MyTextEdit::insertFromMimeData(const QMimeData *source) {
     // QTextEdit's default implementation ignores clipboard image data, which
     // is why pasting a copied picture did nothing. Handle it here.
     if (source->hasImage()) {
-        QImage image = qvariant_cast<QImage>(source->imageData());
-        if (image.isNull()) {
-            QTextEdit::insertFromMimeData(source);
-            return;
-        }
-
         // Ask how wide the image should appear, matching the prompt shown by
         // Insert ▸ Image. Cancelling the dialog cancels the paste.
         QStringList options;
@@ -147,27 +159,35 @@ void MyTextEdit::insertFromMimeData(const QMimeData *source) {
             return;
         int selectedWidth = widthStr.toInt();
 
-        // Downscale the stored pixels if they're wider than the chosen width,
-        // same as insertImage() does, so the saved file doesn't carry huge
-        // screenshot-sized data for a small displayed image.
-        if (image.width() > selectedWidth)
-            image = image.scaledToWidth(selectedWidth, Qt::SmoothTransformation);
-
-        // Encode as PNG bytes — same storage form used by Insert Image /
-        // Insert Drawing, so saveToFile() can embed it as a data URI.
-        QByteArray ba;
-        QBuffer buffer(&ba);
-        buffer.open(QIODevice::WriteOnly);
-        image.save(&buffer, "PNG");
-        buffer.close();
+        // Prefer the encoded bytes the source offers (image/png, image/jpeg,
+        // ...) so they go through the same ingest as Insert Image and keep
+        // their container; only fall back to Qt's already-decoded QImage,
+        // stored as PNG, when there are none.
+        QByteArray ba, format;
+        const QStringList formats = source->formats();
+        for (const QString &fmt : formats) {
+            if (!fmt.startsWith(QLatin1String("image/"))) continue;
+            ba = ImageIngest::ingest(source->data(fmt), selectedWidth, &format);
+            if (!ba.isEmpty()) break;
+        }
+        if (ba.isEmpty()) {
+            const QImage image = ImageIngest::fitToWidth(
+                qvariant_cast<QImage>(source->imageData()), selectedWidth);
+            if (image.isNull()) {
+                QTextEdit::insertFromMimeData(source);
+                return;
+            }
+            ba = ImageIngest::encodePng(image);
+            format = "png";
+        }
 
         // The "myimage/" prefix matters: the save routine's regex looks for
         // it when embedding images into the saved HTML.
         QString resourceName =
             "myimage/pasted_" +
-            QUuid::createUuid().toString(QUuid::Id128).left(8) + ".png";
-        document()->addResource(QTextDocument::ImageResource,
-                                QUrl(resourceName), ba);
+            QUuid::createUuid().toString(QUuid::Id128).left(8) + "." +
+            ImageIngest::suffixFor(format);
+        ImageStore::add(document(), resourceName, ba);
 
         QTextImageFormat imageFormat;
         imageFormat.setName(resourceName);
@@ -188,6 +208,38 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     spellHighlighter = new SpellHighlighter(editor->document());
     editor->setSpellHighlighter(spellHighlighter);
 
+    // Inline images are painted from a cache of display-sized pixmaps
+    // instead of being rescaled from the stored picture on every frame
+    imageHandler = new InlineImageHandler(this);
+    imageHandler->memory().setBudget(
+        QSettings().value("images/memoryBudgetMB",
+                          ImageMemoryManager::DEFAULT_BUDGET / (1024 * 1024))
+            .toLongLong() * 1024 * 1024);
+    imageHandler->install(editor->document());
+    connect(imageHandler, &InlineImageHandler::imageReady,
+            editor, &MyTextEdit::updateDocumentRect);
+
+    CompressionPolicy::setMode(CompressionPolicy::modeFromName(
+        QSettings().value("save/compression").toByteArray()));
+
+    // Bounds on .docx imports; the defaults suit files from anywhere
+    {
+        QSettings settings;
+        DocxConverter::ImportLimits limits;
+        limits.maxTotalBytes =
+            settings.value("import/maxTotalMB", limits.maxTotalBytes >> 20)
+                .toLongLong() << 20;
+        limits.maxRatio =
+            settings.value("import/maxRatio", limits.maxRatio).toInt();
+        limits.maxImagePixels =
+            settings.value("import/maxImageMegapixels",
+                           limits.maxImagePixels / 1000000)
+                .toLongLong() * 1000000;
+        limits.maxParagraphs =
+            settings.value("import/maxParagraphs", limits.maxParagraphs).toInt();
+        DocxConverter::setImportLimits(limits);
+    }
+
     // In-window document-name bar. The OS title bar is unreliable on many
     // Linux desktops (it may not render the window title at all), so we show
     // the current document name in a label directly above the editor.
@@ -207,6 +259,21 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 
     connect(editor->document(), &QTextDocument::documentLayoutChanged, this, &MainWindow::onDocumentLayoutChanged);
 
+    // Progressive file loading, with its progress shown in the status bar
+    loader = new ProgressiveLoader(this);
+    connect(loader, &ProgressiveLoader::chunkReady, this, &MainWindow::appendLoadedChunk);
+    connect(loader, &ProgressiveLoader::finished, this, &MainWindow::onLoadFinished);
+    loadProgress = new QProgressBar(this);
+    loadProgress->setRange(0, 100);
+    loadProgress->setMaximumWidth(200);
+    loadCancel = new QPushButton(tr("Cancel"), this);
+    connect(loader, &ProgressiveLoader::progress, loadProgress, &QProgressBar::setValue);
+    connect(loadCancel, &QPushButton::clicked, this, &MainWindow::cancelLoading);
+    statusBar()->addPermanentWidget(loadProgress);
+    statusBar()->addPermanentWidget(loadCancel);
+    loadProgress->hide();
+    loadCancel->hide();
+
     // File Menu
     QMenu *fileMenu = menuBar()->addMenu(tr("&File"));
     QAction *newAct = fileMenu->addAction(tr("&New"), this, &MainWindow::newFile);
@@ -216,6 +283,16 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     QAction *saveAct = fileMenu->addAction(tr("&Save"), this, &MainWindow::saveFile);
     saveAct->setShortcut(QKeySequence::Save);
     QAction *saveAsAct = fileMenu->addAction(tr("Save &As"), this, &MainWindow::saveAsFile);
+    QMenu *compressionMenu = fileMenu->addMenu(tr(".docx &Compression"));
+    QActionGroup *compressionGroup = new QActionGroup(this);
+    QAction *smallFileAct = compressionMenu->addAction(tr("&Smaller Files"), this, &MainWindow::setSmallFileSave);
+    QAction *fastSaveAct = compressionMenu->addAction(tr("&Faster Saving"), this, &MainWindow::setFastSave);
+    for (QAction *act : {smallFileAct, fastSaveAct}) {
+        act->setCheckable(true);
+        compressionGroup->addAction(act);
+    }
+    (CompressionPolicy::mode() == CompressionPolicy::Mode::FastSave ? fastSaveAct : smallFileAct)
+        ->setChecked(true);
     fileMenu->addSeparator();
     QAction *pageSetupAct = fileMenu->addAction(tr("Page &Setup"), this, &MainWindow::pageSetup);
     fileMenu->addSeparator();
@@ -261,6 +338,8 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     QMenu *themeMenu = viewMenu->addMenu(tr("&Theme"));
     QAction *lightThemeAct = themeMenu->addAction(tr("Light (Black on White)"), this, &MainWindow::setLightTheme);
     QAction *darkThemeAct = themeMenu->addAction(tr("Dark (White on Black)"), this, &MainWindow::setDarkTheme);
+    viewMenu->addSeparator();
+    viewMenu->addAction(tr("Image &Memory..."), this, &MainWindow::showImageMemory);
 
     // Toolbar
     QToolBar *toolBar = addToolBar(tr("Tools"));
@@ -285,10 +364,77 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     setLightTheme();
 }
 
-MainWindow::~MainWindow() {}
+MainWindow::~MainWindow() {
+    // The import job posts back to this window; let it stop first
+    if (docxImport) docxImport->cancel = true;
+    importPool.waitForDone();
+}
+
+// ─── BulkEdit ───────────────────────────────────────────────────────────────
+
+MainWindow::BulkEdit::BulkEdit(MainWindow *window, Range range)
+    : w(window), outer(window->activeBulkEdit), range(range) {
+    if (outer) return;
+    w->activeBulkEdit = this;
+
+    QTextDocument *doc = w->editor->document();
+    startPos = w->editor->textCursor().selectionStart();
+    startCharCount = doc->characterCount();
+
+    updatesWereEnabled = w->editor->updatesEnabled();
+    w->spellHighlighter->suspendHighlighting();
+    doc->blockSignals(true);
+    w->editor->setUpdatesEnabled(false);
+}
+
+void MainWindow::BulkEdit::markDirty(int from, int length) {
+    if (outer) {
+        outer->markDirty(from, length);
+        return;
+    }
+    const int to = from + qMax(0, length);
+    dirtyFrom = dirtyFrom < 0 ? from : qMin(dirtyFrom, from);
+    dirtyTo = qMax(dirtyTo, to);
+}
+
+MainWindow::BulkEdit::~BulkEdit() {
+    if (outer) return;
+    w->activeBulkEdit = nullptr;
+
+    QTextDocument *doc = w->editor->document();
+
+    // Whatever was inserted at (or replaced from) the cursor
+    const int grown = doc->characterCount() - startCharCount;
+    const int endPos = w->editor->textCursor().position();
+    if (range == FollowCursor && (grown != 0 || endPos != startPos)) {
+        const int from = qMin(startPos, endPos);
+        markDirty(from, qMax(endPos, startPos + grown) - from);
+    }
+
+    doc->blockSignals(false);
+
+    QTextBlock first, last;
+    if (dirtyFrom >= 0) {
+        const int lastPos = qMax(0, doc->characterCount() - 1);
+        const int from = qBound(0, dirtyFrom, lastPos);
+        const int to = qBound(from, dirtyTo, lastPos);
+        first = doc->findBlock(from);
+        last = doc->findBlock(to);
+        // Relayout from the start of the first changed block through the
+        // end of the last one
+        doc->markContentsDirty(first.position(),
+                               last.position() + last.length() - first.position());
+    }
+
+    w->editor->setUpdatesEnabled(updatesWereEnabled);
+    w->editor->viewport()->update();
+    w->spellHighlighter->resumeHighlighting(first, last);
+}
 
 void MainWindow::newFile() {
+    stopLoading();
     editor->clear();
+    imageHandler->clear();
     currentFilePath.clear();
     updateWindowTitle();
 }
@@ -301,34 +447,9 @@ void MainWindow::openFile() {
            "Word Documents (*.docx);;All Files (*)"));
     if (filePath.isEmpty()) return;
 
-    // ── .docx: convert to our native HTML representation ─────────────────
+    // ── .docx: built on a worker, straight into a new document ───────────
     if (filePath.endsWith(".docx", Qt::CaseInsensitive)) {
-        QString html, error;
-        QHash<QString, QByteArray> images;
-        if (!DocxConverter::importDocx(filePath, html, images, &error)) {
-            QMessageBox::warning(this, tr("Open Failed"), error);
-            return;
-        }
-
-        spellHighlighter->disableSpellChecking();
-        editor->document()->blockSignals(true);
-        editor->setUpdatesEnabled(false);
-
-        editor->setHtml(html);
-        for (auto it = images.constBegin(); it != images.constEnd(); ++it) {
-            editor->document()->addResource(
-                QTextDocument::ImageResource, QUrl(it.key()), it.value());
-        }
-        editor->document()->markContentsDirty(
-            0, editor->document()->characterCount());
-
-        editor->document()->blockSignals(false);
-        editor->setUpdatesEnabled(true);
-        editor->viewport()->update();
-        spellHighlighter->enableSpellChecking();
-
-        currentFilePath = filePath;
-        updateWindowTitle();
+        startDocxImport(filePath);
         return;
     }
 
@@ -350,74 +471,222 @@ void MainWindow::openFile() {
     QString html = in.readAll();
     file.close();
 
-    // ----------------------------------------------------------------
-    // Pre-process: Qt's setHtml() does NOT support data: URIs in <img>
-    // src attributes — it renders the raw URI as text instead of an
-    // image.  We therefore:
-    //   1. Find every data URI in the HTML.
-    //   2. Replace it with a plain "myimage/..." resource name.
-    //   3. Decode the base64 bytes and keep them in a map.
-    //   4. After setHtml(), register each image as a document resource
-    //      so Qt's layout engine can find and render it.
-    // ----------------------------------------------------------------
-    QHash<QString, QByteArray> imageResources;
-    // Matches:  src="data:image/png;base64,<base64data>"
-    //   cap(1) = format extension ("png", "jpg", …)
-    //   cap(2) = raw base64 string
-    QRegularExpression dataUriRx(
-        "src=\"data:image/([a-zA-Z]+);base64,([^\"]+)\"",
-        QRegularExpression::DotMatchesEverythingOption);
-
-    QRegularExpressionMatchIterator it = dataUriRx.globalMatch(html);
-    QList<QRegularExpressionMatch> matches;
-    while (it.hasNext())
-        matches.append(it.next());
-
-    // Process in reverse so earlier replacements don't shift later offsets
-    int counter = 0;
-    for (int idx = matches.size() - 1; idx >= 0; --idx) {
-        const auto &match = matches[idx];
-        QString fmt  = match.captured(1);               // e.g. "png"
-        QString b64  = match.captured(2);               // raw base64
-
-        QString resourceName =
-            QString("myimage/loaded_%1.%2").arg(counter++).arg(fmt);
+    // Embedded data-URI images are pulled out chunk by chunk as the
+    // document streams in (see appendLoadedChunk)
+    currentFilePath = filePath;
+    updateWindowTitle();
+    startLoading(html, {});
+}
 
-        QByteArray ba = QByteArray::fromBase64(b64.toLatin1());
-        imageResources[resourceName] = ba;
+// ─── Progressive loading ────────────────────────────────────────────────────
+
+void MainWindow::startLoading(const QString &html,
+                              const QHash<QString, QByteArray> &resources) {
+    stopLoading();
+    loadResources = resources;
+    loadedImageCount = 0;
+
+    // Only the loaded part may be edited, so nothing can be until it's all
+    // in; undo is off so the appends don't land on the undo stack
+    editor->setReadOnly(true);
+    editor->document()->setUndoRedoEnabled(false);
+    loadProgress->setValue(0);
+    statusBar()->showMessage(tr("Loading %1…").arg(QFileInfo(currentFilePath).fileName()));
+
+    // Shows the first screenful before returning; the progress widgets only
+    // appear if there's more to come
+    loader->start(html);
+    if (loader->isLoading()) {
+        loadProgress->show();
+        loadCancel->show();
+    }
+}
 
-        // Replace  src="data:image/png;base64,…"  with  src="myimage/loaded_N.png"
-        html.replace(match.capturedStart(), match.capturedLength(),
-                     QString("src=\"%1\"").arg(resourceName));
+void MainWindow::appendLoadedChunk(const QString &html, bool first) {
+    QHash<QString, QByteArray> images;
+    const QString chunk = HtmlImages::extractDataUris(html, loadedImageCount, images);
+    QTextDocument *doc = editor->document();
+
+    if (first) {
+        BulkEdit bulk(this);
+        imageHandler->clear();
+        editor->setHtml(chunk);
+
+        // Register every image so the layout engine can render them.
+        // Must happen AFTER setHtml() because setHtml() clears the document.
+        for (auto it = loadResources.constBegin(); it != loadResources.constEnd(); ++it)
+            ImageStore::add(doc, it.key(), it.value());
+        loadResources.clear();
+        for (auto it = images.constBegin(); it != images.constEnd(); ++it)
+            ImageStore::add(doc, it.key(), it.value());
+
+        // The whole document is new
+        bulk.markDirty(0, doc->characterCount());
+        return;
     }
 
-    // Load the (now resource-name-based) HTML
-    spellHighlighter->disableSpellChecking();
-    editor->document()->blockSignals(true);
-    editor->setUpdatesEnabled(false);
+    for (auto it = images.constBegin(); it != images.constEnd(); ++it)
+        ImageStore::add(doc, it.key(), it.value());
+
+    // Parse the chunk on its own, then append it as a new block that takes
+    // the formats of the chunk's first paragraph (inserting a fragment
+    // merges its first block into the one at the cursor).
+    QTextDocument part;
+    part.setHtml(chunk);
+    QTextCursor all(&part);
+    all.select(QTextCursor::Document);
+    const QTextBlock head = part.firstBlock();
+
+    BulkEdit bulk(this, BulkEdit::ExplicitOnly);
+    QTextCursor cursor(doc);
+    cursor.movePosition(QTextCursor::End);
+    const int from = cursor.position();
+    cursor.insertBlock(head.blockFormat(), head.charFormat());
+    cursor.insertFragment(QTextDocumentFragment(all));
+    bulk.markDirty(from, cursor.position() - from);
+}
 
-    editor->setHtml(html);
+void MainWindow::onLoadFinished() {
+    editor->setReadOnly(false);
+    editor->document()->setUndoRedoEnabled(true);
+    loadProgress->hide();
+    loadCancel->hide();
+    statusBar()->clearMessage();
+}
 
-    // Register every image so the layout engine can render them.
-    // Must happen AFTER setHtml() because setHtml() clears the document.
-    for (auto it2 = imageResources.constBegin(); it2 != imageResources.constEnd(); ++it2) {
-        editor->document()->addResource(
-            QTextDocument::ImageResource, QUrl(it2.key()), it2.value());
+void MainWindow::finishLoading() {
+    // Saving or printing needs the whole document
+    if (loader->isLoading()) {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        loader->finish();
+        QApplication::restoreOverrideCursor();
+    }
+}
+
+void MainWindow::stopLoading() {
+    if (docxImport) {
+        docxImport->cancel = true;
+        docxImport.reset(); // its result is dropped when it arrives
+        onLoadFinished();
+    }
+    if (!loader->isLoading()) return;
+    loader->cancel();
+    loadResources.clear();
+    onLoadFinished();
+}
+
+void MainWindow::cancelLoading() {
+    if (docxImport) {
+        // The document on screen is still the old one, whole
+        stopLoading();
+        statusBar()->showMessage(tr("Opening canceled."), 5000);
+        return;
     }
+    if (!loader->isLoading()) return;
+    stopLoading();
+    // What's shown is only part of the file: make sure Save can't write it
+    // back over the original
+    currentFilePath.clear();
+    updateWindowTitle();
+    statusBar()->showMessage(tr("Loading canceled; the document is incomplete."), 5000);
+}
 
-    // Force the layout to re-evaluate now that resources are present
-    editor->document()->markContentsDirty(0, editor->document()->characterCount());
+// ─── .docx import ───────────────────────────────────────────────────────────
+
+struct MainWindow::DocxImport {
+    QString filePath;
+    std::atomic<bool> cancel{false};
+    int percent = -1; // last reported; only touched by the worker
+};
+
+void MainWindow::startDocxImport(const QString &filePath) {
+    stopLoading();
+    auto import = QSharedPointer<DocxImport>::create();
+    import->filePath = filePath;
+    docxImport = import;
+
+    editor->setReadOnly(true);
+    loadProgress->setValue(0);
+    loadProgress->show();
+    loadCancel->show();
+    statusBar()->showMessage(tr("Loading %1…").arg(QFileInfo(filePath).fileName()));
+
+    importPool.start(QRunnable::create([this, import] {
+        // Built here, then handed to the GUI thread whole
+        auto *doc = new QTextDocument;
+        QString error;
+        const bool ok = DocxConverter::importDocx(
+            import->filePath, doc, &error,
+            [this, import](const DocxConverter::ImportProgress &p) {
+                const int percent = p.bytesTotal > 0
+                    ? int(p.bytesInflated * 100 / p.bytesTotal) : 0;
+                if (percent == import->percent) return;
+                import->percent = percent;
+                const int paragraphs = p.paragraphs;
+                QMetaObject::invokeMethod(this, [this, import, percent, paragraphs]() {
+                    if (docxImport != import) return;
+                    loadProgress->setValue(percent);
+                    statusBar()->showMessage(tr("Loading %1… %2 paragraphs")
+                        .arg(QFileInfo(import->filePath).fileName())
+                        .arg(paragraphs));
+                }, Qt::QueuedConnection);
+            },
+            &import->cancel);
+        doc->moveToThread(QApplication::instance()->thread());
+        QMetaObject::invokeMethod(this, [this, import, doc, ok, error]() {
+            docxImportFinished(import, doc, ok, error);
+        }, Qt::QueuedConnection);
+    }));
+}
 
-    editor->document()->blockSignals(false);
-    editor->setUpdatesEnabled(true);
-    editor->viewport()->update();
+void MainWindow::docxImportFinished(const QSharedPointer<DocxImport> &import,
+                                    QTextDocument *doc, bool ok,
+                                    const QString &error) {
+    if (import != docxImport) { // canceled, or another file opened since
+        delete doc;
+        return;
+    }
+    docxImport.reset();
+    onLoadFinished();
 
-    spellHighlighter->enableSpellChecking();
+    if (!ok) {
+        // Nothing of the file reached the editor
+        delete doc;
+        QMessageBox::warning(this, tr("Open Failed"), error);
+        return;
+    }
 
-    currentFilePath = filePath;
+    replaceDocument(doc);
+    currentFilePath = import->filePath;
     updateWindowTitle();
 }
 
+void MainWindow::replaceDocument(QTextDocument *doc) {
+    QTextDocument *old = editor->document();
+    const bool ownsOld = old->parent() == editor;
+
+    // What the editor had set up on its document
+    doc->setDefaultFont(old->defaultFont());
+    doc->setDefaultTextOption(old->defaultTextOption());
+    doc->setDefaultStyleSheet(old->defaultStyleSheet());
+    doc->setDocumentMargin(old->documentMargin());
+    doc->setParent(editor);
+
+    // The highlighter is a child of the document it checks: move it
+    // across before the old one (and its children) is deleted
+    spellHighlighter->suspendHighlighting();
+    spellHighlighter->setParent(doc);
+    spellHighlighter->setDocument(doc); // rehighlights from the event loop
+
+    imageHandler->clear();
+    editor->setDocument(doc); // deletes the old document if the editor made it
+    imageHandler->install(doc);
+    connect(doc, &QTextDocument::documentLayoutChanged, this, &MainWindow::onDocumentLayoutChanged);
+    spellHighlighter->resumeHighlighting(QTextBlock(), QTextBlock());
+
+    if (ownsOld) delete old;
+}
+
 void MainWindow::saveFile() {
     if (currentFilePath.isEmpty()) {
         saveAsFile();
@@ -448,85 +717,13 @@ void MainWindow::saveAsFile() {
 }
 
 void MainWindow::saveToFile(const QString &filePath) {
-    // ── .docx export path ────────────────────────────────────────────────
-    if (filePath.endsWith(".docx", Qt::CaseInsensitive)) {
-        QString error;
-        if (!DocxConverter::exportDocx(editor->document(), filePath, &error)) {
-            QMessageBox::warning(this, tr("Save Failed"), error);
-            return;
-        }
-        currentFilePath = filePath;
-        return;
-    }
+    finishLoading();
 
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QMessageBox::warning(this, tr("Error"), tr("Cannot write file %1").arg(filePath));
+    QString error;
+    if (!Conversion::save(editor->document(), filePath, &error)) {
+        QMessageBox::warning(this, tr("Save Failed"), error);
         return;
     }
-
-    QString html = editor->toHtml();
-
-    // ----------------------------------------------------------------
-    // Embed every internal image resource as a base64 data URI so the
-    // file is self-contained and images survive a save/reload cycle.
-    //
-    // Two bugs fixed vs. the original code:
-    //
-    //  1. Qt may internally decode a stored QByteArray resource into a
-    //     QImage for rendering.  When we later call document()->resource()
-    //     it may come back as QImage rather than QByteArray.  We handle
-    //     both cases.
-    //
-    //  2. The original code iterated matches *forwards* and then called
-    //     html.replace(offset, len, newText).  Once the first replacement
-    //     changes the string length every subsequent stored offset is
-    //     wrong.  We collect all matches first, then process them in
-    //     *reverse* order so earlier replacements don't shift later ones.
-    // ----------------------------------------------------------------
-    QRegularExpression imgRx(
-        "<img\\s+[^>]*src\\s*=\\s*\"(myimage/[^\"]+)\"[^>]*>");
-
-    QRegularExpressionMatchIterator it = imgRx.globalMatch(html);
-    QList<QRegularExpressionMatch> matches;
-    while (it.hasNext())
-        matches.append(it.next());
-
-    for (int idx = matches.size() - 1; idx >= 0; --idx) {
-        const auto &match = matches[idx];
-        QString resourceName = match.captured(1);
-
-        QVariant resource = editor->document()->resource(
-            QTextDocument::ImageResource, QUrl(resourceName));
-
-        QByteArray ba;
-        if (resource.typeId() == QMetaType::QByteArray) {
-            // Resource is still in its original encoded form
-            ba = resource.toByteArray();
-        } else if (resource.canConvert<QImage>()) {
-            // Qt decoded it to QImage internally for rendering — re-encode
-            QImage img = resource.value<QImage>();
-            QBuffer buf(&ba);
-            buf.open(QIODevice::WriteOnly);
-            img.save(&buf, "PNG");
-            buf.close();
-        } else {
-            qDebug() << "saveToFile: resource not found or unknown type:" << resourceName;
-            continue;
-        }
-
-        QString base64  = QString::fromLatin1(ba.toBase64());
-        QString dataUrl = "data:image/png;base64," + base64;
-
-        // Splice the data URI into the tag in-place
-        QString newTag = match.captured();
-        newTag.replace(resourceName, dataUrl);
-        html.replace(match.capturedStart(), match.capturedLength(), newTag);
-    }
-
-    QTextStream out(&file);
-    out << html;
-    file.close();
     currentFilePath = filePath;
 }
 
@@ -559,11 +756,12 @@ void MainWindow::insertImage() {
     timer.start();
 
     QString imagePath = QFileDialog::getOpenFileName(
-        this, tr("Insert Image"), "", tr("Image Files (*.png *.jpg *.bmp)"));
+        this, tr("Insert Image"), "",
+        tr("Image Files (*.png *.jpg *.jpeg *.gif *.webp *.bmp)"));
     if (imagePath.isEmpty()) return;
 
-    QImage image(imagePath);
-    if (image.isNull()) {
+    // Header-only probe so a bad file is reported before asking for a width
+    if (!ImageIngest::intrinsicSize(imagePath).isValid()) {
         QMessageBox::warning(this, tr("Image Load Error"), tr("Failed to load image."));
         return;
     }
@@ -576,31 +774,22 @@ void MainWindow::insertImage() {
     if (!ok || widthStr.isEmpty()) return;
     int selectedWidth = widthStr.toInt();
 
-    if (image.width() > selectedWidth)
-        image = image.scaledToWidth(selectedWidth, Qt::FastTransformation);
-
-    editor->setUpdatesEnabled(false);
-    editor->document()->blockSignals(true);
-    spellHighlighter->disableSpellChecking();
-
-    QByteArray ba;
-    QBuffer buffer(&ba);
-    buffer.open(QIODevice::WriteOnly);
-    image.save(&buffer, "PNG");
-    buffer.close();
-
-    QString resourceName = "myimage/" + QFileInfo(imagePath).fileName();
-    editor->document()->addResource(QTextDocument::ImageResource, QUrl(resourceName), ba);
-
-    QTextImageFormat imageFormat;
-    imageFormat.setName(resourceName);
-    imageFormat.setWidth(selectedWidth);
-    editor->textCursor().insertImage(imageFormat);
+    // Keeps the file's own bytes when they already fit; otherwise decodes
+    // straight at the chosen width rather than loading the full resolution
+    // and scaling afterwards
+    QByteArray format;
+    const QByteArray ba = ImageIngest::ingestFile(imagePath, selectedWidth, &format);
+    if (ba.isEmpty()) {
+        QMessageBox::warning(this, tr("Image Load Error"), tr("Failed to load image."));
+        return;
+    }
 
-    editor->document()->blockSignals(false);
-    editor->setUpdatesEnabled(true);
-    editor->document()->markContentsDirty(0, editor->document()->characterCount());
-    spellHighlighter->enableSpellChecking();
+    // Unique, like pasted pictures and drawings: two files called
+    // photo.jpg (or one edited since) mustn't share a resource
+    QString resourceName = "myimage/" + QFileInfo(imagePath).completeBaseName() +
+                           "_" + QUuid::createUuid().toString(QUuid::Id128).left(8) +
+                           "." + ImageIngest::suffixFor(format);
+    insertImageResource(resourceName, ba, selectedWidth);
 }
 
 void MainWindow::insertDrawing() {
@@ -618,33 +807,31 @@ void MainWindow::insertDrawing() {
     if (!ok || widthStr.isEmpty()) return;
     int selectedWidth = widthStr.toInt();
 
-    if (image.width() > selectedWidth)
-        image = image.scaledToWidth(selectedWidth, Qt::SmoothTransformation);
-
-    editor->setUpdatesEnabled(false);
-    editor->document()->blockSignals(true);
-    spellHighlighter->disableSpellChecking();
-
-    QByteArray ba;
-    QBuffer buffer(&ba);
-    buffer.open(QIODevice::WriteOnly);
-    image.save(&buffer, "PNG");
-    buffer.close();
+    image = ImageIngest::fitToWidth(image, selectedWidth);
+    QByteArray ba = ImageIngest::encodePng(image);
 
     QString resourceName =
         "myimage/drawing_" +
         QUuid::createUuid().toString(QUuid::Id128).left(8) + ".png";
-    editor->document()->addResource(QTextDocument::ImageResource, QUrl(resourceName), ba);
+    insertImageResource(resourceName, ba, selectedWidth);
+}
+
+void MainWindow::insertImageResource(const QString &resourceName,
+                                     const QByteArray &bytes, int width) {
+    // Inserting through the cursor already tells the layout which block
+    // changed; the layout moves the blocks after it without re-laying
+    // them out. BulkEdit then relays out and rehighlights just that block,
+    // so the cost doesn't grow with the length of the document (see
+    // mattword-insertbench).
+    BulkEdit bulk(this);
+
+    ImageStore::add(editor->document(), resourceName, bytes);
+    imageHandler->forget(resourceName);
 
     QTextImageFormat imageFormat;
     imageFormat.setName(resourceName);
-    imageFormat.setWidth(selectedWidth);
+    imageFormat.setWidth(width);
     editor->textCursor().insertImage(imageFormat);
-
-    editor->document()->blockSignals(false);
-    editor->setUpdatesEnabled(true);
-    editor->document()->markContentsDirty(0, editor->document()->characterCount());
-    spellHighlighter->enableSpellChecking();
 }
 
 void MainWindow::print() {
@@ -657,9 +844,13 @@ void MainWindow::print() {
                   rightMargin / 72.0, bottomMargin / 72.0),
         QPageLayout::Inch);
 
-    spellHighlighter->disableSpellChecking();
+    finishLoading();
+
+    // Printing works on a clone of the document, which doesn't carry the
+    // spell-check underlines; checking is only paused so it doesn't run
+    // mid-print, and nothing needs rehighlighting afterwards.
+    BulkEdit bulk(this);
     editor->print(&printer);
-    spellHighlighter->enableSpellChecking();
 }
 
 void MainWindow::pageSetup() {
@@ -727,10 +918,51 @@ void MainWindow::setDarkTheme() {
         "border: 1px solid #ddd; border-radius: 4px; padding: 0px; }");
 }
 
+void MainWindow::setSmallFileSave() {
+    CompressionPolicy::setMode(CompressionPolicy::Mode::SmallFile);
+    QSettings().setValue("save/compression", CompressionPolicy::modeName(CompressionPolicy::Mode::SmallFile));
+}
+
+void MainWindow::setFastSave() {
+    CompressionPolicy::setMode(CompressionPolicy::Mode::FastSave);
+    QSettings().setValue("save/compression", CompressionPolicy::modeName(CompressionPolicy::Mode::FastSave));
+}
+
 void MainWindow::exitApp() {
     qApp->quit();
 }
 
+void MainWindow::showImageMemory() {
+    const ImageMemoryManager::Stats st = imageHandler->memory().stats();
+    const auto mb = [](qint64 bytes) { return QString::number(bytes / (1024.0 * 1024.0), 'f', 1); };
+
+    QMessageBox box(this);
+    box.setWindowTitle(tr("Image Memory"));
+    box.setIcon(QMessageBox::Information);
+    box.setText(tr("Decoded images: %1 MB of %2 MB budget (peak %3 MB)\n"
+                   "Images in memory: %4\n"
+                   "Served from memory: %5\n"
+                   "Shown before decoded: %6\n"
+                   "Evicted to stay in budget: %7")
+                    .arg(mb(st.usedBytes), mb(st.budgetBytes), mb(st.peakBytes))
+                    .arg(st.images)
+                    .arg(st.hits)
+                    .arg(st.misses)
+                    .arg(st.evictions));
+    QPushButton *budgetBtn = box.addButton(tr("Change Budget..."), QMessageBox::ActionRole);
+    box.addButton(QMessageBox::Ok);
+    box.exec();
+    if (box.clickedButton() != budgetBtn) return;
+
+    bool ok;
+    const int budgetMB = QInputDialog::getInt(
+        this, tr("Image Memory Budget"), tr("Budget (MB):"),
+        int(st.budgetBytes / (1024 * 1024)), 8, 4096, 8, &ok);
+    if (!ok) return;
+    imageHandler->memory().setBudget(qint64(budgetMB) * 1024 * 1024);
+    QSettings().setValue("images/memoryBudgetMB", budgetMB);
+}
+
 void MainWindow::updateWindowTitle() {
     QString name = currentFilePath.isEmpty()
         ? tr("Untitled")
@@ -741,5 +973,7 @@ void MainWindow::updateWindowTitle() {
 }
 
 void MainWindow::onDocumentLayoutChanged() {
+    // A fresh layout comes with Qt's default image handler again
+    imageHandler->install(editor->document());
     // qDebug() << "Document layout changed";
 }
@@ -33,8 +33,14 @@
 #include <QUuid>
 #include "spellchecker.h"
 #include "drawingcanvas.h"
+#include "inlineimagehandler.h"
+#include "progressiveloader.h"
 #include <QElapsedTimer>
 #include <QKeyEvent>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QSharedPointer>
+#include <QThreadPool>
 
 // Subclass QTextEdit to expose viewport margins, log paint/update events, and handle key presses
 class MyTextEdit : public QTextEdit {
@@ -44,6 +50,10 @@ public:
     void setMyViewportMargins(int left, int top, int right, int bottom);
     void setSpellHighlighter(SpellHighlighter *highlighter) { spellHighlighter = highlighter; }
 
+public slots:
+    // Repaint one area given in document coordinates
+    void updateDocumentRect(const QRectF &rect);
+
 protected:
     void paintEvent(QPaintEvent *event) override;
     bool viewportEvent(QEvent *event) override;
@@ -82,15 +92,88 @@ private slots:
     void pageSetup();
     void setLightTheme();
     void setDarkTheme();
+    void setSmallFileSave();
+    void setFastSave();
     void exitApp();
+    void showImageMemory();
     void onDocumentLayoutChanged();
+    void appendLoadedChunk(const QString &html, bool first);
+    void onLoadFinished();
+    void cancelLoading();
 
 private:
+    // Scoped batch of programmatic document changes (opening a file,
+    // inserting a picture, printing). While one is alive, spell
+    // highlighting, document signals and editor repaints are paused; when
+    // it goes out of scope only the changed range is relaid out and
+    // rehighlighted, instead of the whole document twice over.
+    //
+    // The changed range is worked out from where the text cursor was and
+    // how much the document grew; edits elsewhere (e.g. replacing the whole
+    // document) must be reported with markDirty(). Nested instances fold
+    // into the outermost one.
+    class BulkEdit {
+    public:
+        // FollowCursor: also treat whatever was inserted at the editor's
+        // cursor as changed. ExplicitOnly: just the markDirty() ranges,
+        // for edits made through a separate cursor.
+        enum Range { FollowCursor, ExplicitOnly };
+
+        explicit BulkEdit(MainWindow *window, Range range = FollowCursor);
+        ~BulkEdit();
+        BulkEdit(const BulkEdit &) = delete;
+        BulkEdit &operator=(const BulkEdit &) = delete;
+
+        // Add [from, from + length) (document positions) to the range
+        void markDirty(int from, int length);
+
+    private:
+        MainWindow *w;
+        BulkEdit *outer;
+        Range range;
+        int startPos = 0;
+        int startCharCount = 0;
+        int dirtyFrom = -1;
+        int dirtyTo = -1;
+        bool updatesWereEnabled = true;
+    };
+    BulkEdit *activeBulkEdit = nullptr;
+
+    // Register `bytes` under `resourceName` and insert it at the cursor,
+    // shown `width` pixels wide
+    void insertImageResource(const QString &resourceName,
+                             const QByteArray &bytes, int width);
+
     MyTextEdit *editor;
     QLabel *titleLabel = nullptr;
     SpellHighlighter *spellHighlighter;
+    InlineImageHandler *imageHandler;
     QString currentFilePath;
 
+    // Opening a file streams it in through `loader`; until it's done the
+    // editor is read-only and the status bar shows how far it has got
+    ProgressiveLoader *loader;
+    QProgressBar *loadProgress;
+    QPushButton *loadCancel;
+    QHash<QString, QByteArray> loadResources; // registered with the first chunk
+    int loadedImageCount = 0;
+
+    void startLoading(const QString &html, const QHash<QString, QByteArray> &resources);
+    void finishLoading();
+    void stopLoading();
+
+    // A .docx is imported on `importPool` into a document of its own, which
+    // replaces the editor's when it's complete; meanwhile the old one stays
+    // up, read-only, with the same progress bar and Cancel button
+    struct DocxImport;
+    QSharedPointer<DocxImport> docxImport; // the one in progress, if any
+    QThreadPool importPool;
+    void startDocxImport(const QString &filePath);
+    void docxImportFinished(const QSharedPointer<DocxImport> &import,
+                            QTextDocument *doc, bool ok, const QString &error);
+    // Make `doc` (on the GUI thread, unowned) the editor's document
+    void replaceDocument(QTextDocument *doc);
+
     // Page and margin settings (in points; 1 inch = 72 points)
     QPageSize::PageSizeId pageSizeId = QPageSize::Letter;
     double leftMargin = 72.0;
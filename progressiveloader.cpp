@@ -0,0 +1,144 @@
+#include "progressiveloader.h"
+
+#include <QElapsedTimer>
+#include <QStringView>
+
+namespace {
+
+// Elements a chunk may end after. Anything nested inside them (spans,
+// images, list items, table cells) always travels with its parent.
+bool isBlockTag(QStringView name) {
+    static const char *const tags[] = {
+        "p", "div", "table", "ul", "ol", "dl", "pre", "blockquote", "center",
+        "h1", "h2", "h3", "h4", "h5", "h6",
+    };
+    for (const char *tag : tags) {
+        if (name.compare(QLatin1String(tag), Qt::CaseInsensitive) == 0)
+            return true;
+    }
+    return false;
+}
+
+} // anonymous namespace
+
+ProgressiveLoader::ProgressiveLoader(QObject *parent) : QObject(parent) {
+    timer.setSingleShot(true);
+    timer.setInterval(0);
+    connect(&timer, &QTimer::timeout, this, &ProgressiveLoader::step);
+}
+
+void ProgressiveLoader::start(const QString &html) {
+    cancel();
+    source = html;
+
+    // Without a <body> tag the whole text is taken as body content
+    const int bodyTag = source.indexOf(QLatin1String("<body"), 0, Qt::CaseInsensitive);
+    const int bodyOpenEnd = bodyTag >= 0 ? source.indexOf(QLatin1Char('>'), bodyTag) : -1;
+    if (bodyOpenEnd >= 0) {
+        prefix = source.left(bodyOpenEnd + 1);
+        bodyStart = bodyOpenEnd + 1;
+        bodyEnd = source.lastIndexOf(QLatin1String("</body"), -1, Qt::CaseInsensitive);
+        if (bodyEnd < bodyStart) bodyEnd = source.size();
+    } else {
+        prefix.clear();
+        bodyStart = 0;
+        bodyEnd = source.size();
+    }
+    pos = bodyStart;
+    loading = true;
+
+    emit chunkReady(nextChunk(FIRST_CHUNK_CHARS), true);
+    if (pos < bodyEnd) {
+        emit progress(0);
+        timer.start();
+    } else {
+        complete();
+    }
+}
+
+void ProgressiveLoader::cancel() {
+    timer.stop();
+    loading = false;
+    source.clear();
+    prefix.clear();
+}
+
+void ProgressiveLoader::finish() {
+    if (!loading) return;
+    timer.stop();
+    while (loading && pos < bodyEnd)
+        emit chunkReady(nextChunk(CHUNK_CHARS), false);
+    if (loading) complete();
+}
+
+void ProgressiveLoader::step() {
+    if (!loading) return;
+
+    QElapsedTimer slice;
+    slice.start();
+    do {
+        emit chunkReady(nextChunk(CHUNK_CHARS), false);
+        // A slot may have cancelled or restarted us
+        if (!loading) return;
+    } while (pos < bodyEnd && slice.elapsed() < SLICE_MS);
+
+    if (pos < bodyEnd) {
+        emit progress(int(qint64(pos - bodyStart) * 100 / qMax(1, bodyEnd - bodyStart)));
+        timer.start();
+    } else {
+        complete();
+    }
+}
+
+void ProgressiveLoader::complete() {
+    cancel();
+    emit progress(100);
+    emit finished();
+}
+
+QString ProgressiveLoader::nextChunk(int minChars) {
+    // Walk the tags from `pos`, tracking how deep we are in block elements,
+    // and cut after the first closing block tag at depth 0 once the chunk
+    // is long enough. Long attribute values (base64 images) are skipped in
+    // a single indexOf().
+    int depth = 0;
+    int cut = bodyEnd;
+    int i = pos;
+    while (i < bodyEnd) {
+        const int lt = source.indexOf(QLatin1Char('<'), i);
+        if (lt < 0 || lt >= bodyEnd) break;
+
+        if (QStringView(source).mid(lt).startsWith(QLatin1String("<!--"))) {
+            const int close = source.indexOf(QLatin1String("-->"), lt + 4);
+            i = close < 0 ? bodyEnd : close + 3;
+            continue;
+        }
+
+        const int gt = source.indexOf(QLatin1Char('>'), lt);
+        if (gt < 0 || gt >= bodyEnd) break;
+
+        const bool closing = lt + 1 < gt && source.at(lt + 1) == QLatin1Char('/');
+        const int nameStart = lt + (closing ? 2 : 1);
+        int nameEnd = nameStart;
+        while (nameEnd < gt && source.at(nameEnd).isLetterOrNumber()) ++nameEnd;
+        const QStringView name = QStringView(source).mid(nameStart, nameEnd - nameStart);
+        const bool selfClosing = source.at(gt - 1) == QLatin1Char('/');
+
+        i = gt + 1;
+        if (!isBlockTag(name)) continue;
+        if (closing) {
+            if (depth > 0) --depth;
+            if (depth == 0 && i - pos >= minChars) {
+                cut = i;
+                break;
+            }
+        } else if (!selfClosing) {
+            ++depth;
+        }
+    }
+
+    const QString body = source.mid(pos, cut - pos);
+    pos = cut;
+    if (prefix.isEmpty()) return body;
+    return prefix + body + QLatin1String("</body></html>");
+}
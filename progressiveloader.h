@@ -0,0 +1,65 @@
+#ifndef PROGRESSIVELOADER_H
+#define PROGRESSIVELOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+// Feeds a large HTML document to the editor a piece at a time.
+//
+// setHtml() on a whole file parses and lays out every page before anything
+// is shown. Instead the body is cut at top-level block boundaries (a closed
+// <p>, <table>, <ul>, ...) into chunks, each wrapped in the document's own
+// <head> and <body> tag so it parses with the same styles. The first chunk,
+// about a screenful, is handed over from start() itself; the rest follow
+// from the event loop in slices of a few milliseconds so the window stays
+// responsive. Splitting is done lazily as chunks are needed, so the time to
+// the first chunk doesn't depend on the size of the file.
+class ProgressiveLoader : public QObject {
+    Q_OBJECT
+public:
+    // Source characters per chunk. Qt's own HTML runs ~3x the visible text
+    static constexpr int FIRST_CHUNK_CHARS = 16 * 1024;
+    static constexpr int CHUNK_CHARS = 32 * 1024;
+    // Longest the loader holds the event loop per slice
+    static constexpr int SLICE_MS = 12;
+
+    explicit ProgressiveLoader(QObject *parent = nullptr);
+
+    // Begin loading `html`. chunkReady(first = true) is emitted before this
+    // returns; connect to it beforehand. Restarting abandons any load in
+    // progress.
+    void start(const QString &html);
+
+    // Stop without delivering anything more.
+    void cancel();
+
+    // Deliver everything that's left right now (e.g. before saving).
+    void finish();
+
+    bool isLoading() const { return loading; }
+
+signals:
+    // A complete, standalone HTML document holding the next part of the
+    // body. The first one replaces the document; later ones are appended.
+    void chunkReady(const QString &html, bool first);
+    void progress(int percent);
+    void finished();
+
+private slots:
+    void step();
+
+private:
+    QString nextChunk(int minChars);
+    void complete();
+
+    QString source;
+    QString prefix;       // everything up to and including <body ...>
+    int bodyStart = 0;
+    int bodyEnd = 0;      // position of </body>, or the end of the source
+    int pos = 0;
+    bool loading = false;
+    QTimer timer;
+};
+
+#endif // PROGRESSIVELOADER_H
@@ -0,0 +1,63 @@
+// server.cpp — mattword-server: conversion service on a local socket
+// (see ConversionServer for the protocol).
+#include "conversionserver.h"
+#include "conversion.h"
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QTextDocument>
+#include <cstdio>
+
+int main(int argc, char *argv[]) {
+    // Fonts and images need a QGuiApplication, but not a display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("MattWord");
+    QCoreApplication::setApplicationName("mattword-server");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Serve HTML/.docx/PDF conversions on a local socket.");
+    parser.addHelpOption();
+    const QCommandLineOption socketOpt(
+        QStringList() << "s" << "socket", "Socket name or path (default: mattword).",
+        "name", "mattword");
+    const QCommandLineOption jobsOpt(
+        QStringList() << "j" << "jobs", "Worker threads (default: one per core).", "N");
+    const QCommandLineOption queueOpt(
+        "max-queue", "Requests allowed to wait for a worker before Busy (default: 64).",
+        "N", "64");
+    const QCommandLineOption timeoutOpt(
+        "timeout", "Per-request time limit in seconds, 0 for none (default: 30).",
+        "seconds", "30");
+    const QCommandLineOption maxSizeOpt(
+        "max-request-mb", "Largest request accepted, in MB (default: 256).", "MB", "256");
+    parser.addOptions({socketOpt, jobsOpt, queueOpt, timeoutOpt, maxSizeOpt});
+    parser.process(app);
+
+    ConversionServer::Options options;
+    options.workers = parser.value(jobsOpt).toInt();
+    options.maxQueue = qMax(0, parser.value(queueOpt).toInt());
+    options.timeoutMs = qMax(0, parser.value(timeoutOpt).toInt()) * 1000;
+    options.maxRequestBytes = qMax(1, parser.value(maxSizeOpt).toInt()) * qint64(1024 * 1024);
+
+    // Pay for font and codec setup now rather than on the first request
+    {
+        QTextDocument doc;
+        QByteArray out;
+        Conversion::loadData(&doc, "<p>MattWord</p>", Conversion::Format::Html);
+        Conversion::saveData(&doc, Conversion::Format::Docx, out);
+        Conversion::saveData(&doc, Conversion::Format::Pdf, out);
+    }
+
+    ConversionServer server(options);
+    QString error;
+    const QString name = parser.value(socketOpt);
+    if (!server.listen(name, &error)) {
+        std::fprintf(stderr, "mattword-server: cannot listen on %s: %s\n",
+                     qPrintable(name), qPrintable(error));
+        return 1;
+    }
+    return app.exec();
+}
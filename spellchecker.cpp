@@ -56,6 +56,30 @@ void SpellHighlighter::enableSpellChecking() {
     rehighlight(); // Force rehighlight to restore underlines
 }
 
+void SpellHighlighter::suspendHighlighting() {
+    if (suspended) return;
+    suspended = true;
+    debounceTimer->stop();
+    modifiedBlocks.clear();
+    QObject::disconnect(contentsChangedConnection);
+}
+
+void SpellHighlighter::resumeHighlighting(const QTextBlock &first, const QTextBlock &last) {
+    if (!suspended) return;
+    suspended = false;
+    if (spellCheckingEnabled) {
+        contentsChangedConnection = QObject::connect(document(), &QTextDocument::contentsChanged,
+                                                    this, &SpellHighlighter::onTextChanged);
+    }
+
+    if (!first.isValid() || !last.isValid()) return;
+    spellCache.clear();
+    for (QTextBlock block = first; block.isValid() && block.blockNumber() <= last.blockNumber();
+         block = block.next()) {
+        rehighlightBlock(block);
+    }
+}
+
 void SpellHighlighter::onTextChanged() {
     spellCache.clear();
     if (spellCheckingEnabled) {
@@ -88,7 +112,7 @@ void SpellHighlighter::onContentsChange(int from, int charsRemoved, int charsAdd
 }
 
 void SpellHighlighter::performSpellCheck() {
-    if (!spellCheckingEnabled) return;
+    if (!spellCheckingEnabled || suspended) return;
 
     QElapsedTimer timer;
     timer.start();
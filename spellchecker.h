@@ -6,6 +6,7 @@
 #include <QProcess>
 #include <QHash>
 #include <QSet>
+#include <QTextBlock>
 
 class SpellHighlighter : public QSyntaxHighlighter {
     Q_OBJECT
@@ -14,6 +15,13 @@ public:
     void disableSpellChecking();
     void enableSpellChecking();
 
+    // Pause checking during a batch of programmatic edits without the full
+    // rehighlight disableSpellChecking() does: existing underlines stay as
+    // they are. resumeHighlighting() then re-checks only the blocks from
+    // `first` to `last` (inclusive; pass invalid blocks for none).
+    void suspendHighlighting();
+    void resumeHighlighting(const QTextBlock &first, const QTextBlock &last);
+
     // Returns true if `word` would currently be flagged as misspelled
     // (respects the ignore list and the user's custom dictionary).
     bool checkMisspelled(const QString &word);
@@ -43,6 +51,7 @@ private:
     QSet<int> modifiedBlocks;
     QMetaObject::Connection contentsChangedConnection;
     bool spellCheckingEnabled = true; // New flag to track spell-checking state
+    bool suspended = false;           // inside suspend/resumeHighlighting()
     bool aspellAvailable = false;     // Whether aspell was found at startup
                                       // (false e.g. on a stock Windows install)
     QSet<QString> ignoredWords;       // session-only, lowercased
@@ -0,0 +1,105 @@
+#include "xmlwriter.h"
+
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+// Plain ASCII that needs no escaping: the bulk of any document
+inline bool isPlain(char16_t c) {
+    return c >= 0x20 && c < 0x80 && c != '&' && c != '<' && c != '>' &&
+           c != '"';
+}
+
+// Units examined per fast-path block. The block test and the narrowing
+// copy are fixed-length loops without early exits, which compilers
+// vectorize.
+constexpr std::size_t BLOCK = 16;
+
+} // anonymous namespace
+
+std::size_t XmlEscape::escapeUtf16(const char16_t *src, std::size_t n, char *dst) {
+    char *const start = dst;
+    std::size_t i = 0;
+    while (i < n) {
+        if (n - i >= BLOCK) {
+            // isPlain() for the whole block, written branch-free
+            unsigned special = 0;
+            for (std::size_t k = 0; k < BLOCK; ++k) {
+                const unsigned c = src[i + k];
+                special |= unsigned(c - 0x20u > 0x5Fu) | unsigned(c == '&') |
+                           unsigned(c == '<') | unsigned(c == '>') |
+                           unsigned(c == '"');
+            }
+            if (!special) {
+                for (std::size_t k = 0; k < BLOCK; ++k)
+                    dst[k] = char(src[i + k]);
+                dst += BLOCK;
+                i += BLOCK;
+                continue;
+            }
+        }
+
+        // One unit at a time until the next block boundary
+        const std::size_t stop = n - i >= BLOCK ? i + BLOCK : n;
+        for (; i < stop; ++i) {
+            const char32_t c = src[i];
+            if (isPlain(char16_t(c))) {
+                *dst++ = char(c);
+            } else if (c < 0x80) {
+                switch (c) {
+                case '&': std::memcpy(dst, "&amp;", 5); dst += 5; break;
+                case '<': std::memcpy(dst, "&lt;", 4); dst += 4; break;
+                case '>': std::memcpy(dst, "&gt;", 4); dst += 4; break;
+                case '"': std::memcpy(dst, "&quot;", 6); dst += 6; break;
+                case '\t': case '\n': case '\r': *dst++ = char(c); break;
+                default: break; // other C0 controls aren't allowed in XML
+                }
+            } else if (c < 0x800) {
+                *dst++ = char(0xC0 | (c >> 6));
+                *dst++ = char(0x80 | (c & 0x3F));
+            } else if (c >= 0xD800 && c <= 0xDFFF) {
+                char32_t cp = 0xFFFD;
+                if (c <= 0xDBFF && i + 1 < n && src[i + 1] >= 0xDC00 &&
+                    src[i + 1] <= 0xDFFF) {
+                    cp = 0x10000 + ((c - 0xD800) << 10) + (src[i + 1] - 0xDC00);
+                    ++i;
+                }
+                if (cp == 0xFFFD) {
+                    std::memcpy(dst, "\xEF\xBF\xBD", 3);
+                    dst += 3;
+                } else {
+                    *dst++ = char(0xF0 | (cp >> 18));
+                    *dst++ = char(0x80 | ((cp >> 12) & 0x3F));
+                    *dst++ = char(0x80 | ((cp >> 6) & 0x3F));
+                    *dst++ = char(0x80 | (cp & 0x3F));
+                }
+            } else if (c == 0xFFFE || c == 0xFFFF) {
+                // Not XML characters either
+            } else {
+                *dst++ = char(0xE0 | (c >> 12));
+                *dst++ = char(0x80 | ((c >> 6) & 0x3F));
+                *dst++ = char(0x80 | (c & 0x3F));
+            }
+        }
+    }
+    return std::size_t(dst - start);
+}
+
+void XmlWriter::number(qint64 value) {
+    char buf[24];
+    const auto result = std::to_chars(buf, buf + sizeof buf, value);
+    out.append(buf, int(result.ptr - buf));
+}
+
+void XmlWriter::text(QStringView s) {
+    if (s.isEmpty()) return;
+    // Grow once to the worst case, write in place, then trim. resize()
+    // never gives capacity back, so a reused buffer stops reallocating.
+    const qsizetype old = out.size();
+    out.resize(old + qsizetype(XmlEscape::maxEscapedSize(std::size_t(s.size()))));
+    const std::size_t written = XmlEscape::escapeUtf16(
+        reinterpret_cast<const char16_t *>(s.utf16()), std::size_t(s.size()),
+        out.data() + old);
+    out.resize(old + qsizetype(written));
+}
@@ -0,0 +1,50 @@
+#ifndef XMLWRITER_H
+#define XMLWRITER_H
+
+#include <QByteArray>
+#include <QStringView>
+#include <cstddef>
+
+// Append-only UTF-8 XML output for the .docx exporter.
+//
+// Everything goes straight into one caller-owned QByteArray that is
+// reused between chunks, so writing a run costs no allocations once the
+// buffer has grown to size: tags are appended as pre-encoded literals,
+// numbers are formatted on the stack, and text is escaped and transcoded
+// from UTF-16 in a single pass.
+class XmlWriter {
+public:
+    explicit XmlWriter(QByteArray &out) : out(out) {}
+
+    // A literal that is already valid, encoded XML
+    template <std::size_t N>
+    void raw(const char (&literal)[N]) { out.append(literal, int(N - 1)); }
+    void raw(const char *data, int size) { out.append(data, size); }
+    void raw(const QByteArray &bytes) { out.append(bytes); }
+
+    void number(qint64 value);
+
+    // Character data / attribute value: & < > " are escaped, characters
+    // XML 1.0 can't carry (most C0 controls) are dropped, unpaired
+    // surrogates become U+FFFD.
+    void text(QStringView s);
+
+    QByteArray &buffer() { return out; }
+
+private:
+    QByteArray &out;
+};
+
+namespace XmlEscape {
+
+// The UTF-8 output for `n` UTF-16 units never exceeds this
+constexpr std::size_t maxEscapedSize(std::size_t n) { return n * 6; }
+
+// Escape and encode `n` UTF-16 units from `src` into `dst`, which must
+// have room for maxEscapedSize(n) bytes. Returns the number of bytes
+// written.
+std::size_t escapeUtf16(const char16_t *src, std::size_t n, char *dst);
+
+} // namespace XmlEscape
+
+#endif // XMLWRITER_H
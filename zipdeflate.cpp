@@ -0,0 +1,186 @@
+#include "zipdeflate.h"
+
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+
+#include <cstring>
+
+struct ZipDeflate::Stream::Chunk {
+    QByteArray in;
+    QByteArray out;
+    bool last = false;
+    bool ok = false;
+    QSemaphore done;     // released once it's compressed
+};
+
+namespace {
+
+// A zip local file header before its name (MZ_ZIP_LOCAL_DIR_HEADER_SIZE,
+// which miniz keeps private)
+constexpr mz_uint64 LOCAL_HEADER_BYTES = 30;
+
+} // anonymous namespace
+
+ZipDeflate::Stream::Stream(int level, QThreadPool *workers, Sink sink,
+                           const Backend &backend)
+    : pool(workers),
+      sink(std::move(sink)),
+      backend(backend),
+      flushing(backend.canFlush() ? backend : minizBackend()),
+      level(level),
+      maxInFlight(pool ? 2 * qMax(1, pool->maxThreadCount()) : 0) {
+    pending.reserve(CHUNK_BYTES);
+}
+
+ZipDeflate::Stream::~Stream() {
+    // Workers write into chunks we own
+    for (const auto &chunk : chunks) chunk->done.acquire();
+}
+
+void ZipDeflate::Stream::write(const char *data, qsizetype size) {
+    crc = mz_uint32(mz_crc32(crc, reinterpret_cast<const mz_uint8 *>(data),
+                             size_t(size)));
+    total += quint64(size);
+    while (size > 0) {
+        const qsizetype n = qMin<qsizetype>(size, CHUNK_BYTES - pending.size());
+        pending.append(data, n);
+        data += n;
+        size -= n;
+        if (pending.size() == CHUNK_BYTES) submit(false);
+    }
+}
+
+void ZipDeflate::Stream::submit(bool last) {
+    auto chunk = QSharedPointer<Chunk>::create();
+    chunk->in = pending;
+    chunk->last = last;
+    chunks.append(chunk);
+    pending = QByteArray();
+    if (!last) pending.reserve(CHUNK_BYTES);
+
+    // Only the last piece may go to a backend that can't flush
+    const Backend &by = last ? backend : flushing;
+    if (!pool) {
+        chunk->ok = by.deflatePiece(chunk->in.constData(), chunk->in.size(),
+                                    chunk->out, level, last);
+        chunk->in = QByteArray();
+        chunk->done.release();
+    } else {
+        pool->start(QRunnable::create([this, chunk, &by] {
+            chunk->ok = by.deflatePiece(chunk->in.constData(),
+                                        chunk->in.size(), chunk->out, level,
+                                        chunk->last);
+            chunk->in = QByteArray();
+            chunk->done.release();
+        }));
+    }
+
+    // Hold at most maxInFlight chunks, compressed or not
+    drain(maxInFlight);
+}
+
+void ZipDeflate::Stream::drain(qsizetype keep) {
+    while (!chunks.isEmpty()) {
+        Chunk &chunk = *chunks.first();
+        if (chunks.size() > keep)
+            chunk.done.acquire();
+        else if (!chunk.done.tryAcquire())
+            break;
+
+        ok = ok && chunk.ok;
+        if (ok) {
+            if (sink)
+                ok = sink(chunk.out);
+            else
+                collected += chunk.out;
+        }
+        chunks.removeFirst();
+    }
+}
+
+ZipDeflate::Compressed ZipDeflate::Stream::finish() {
+    submit(true);
+    drain(0);
+
+    Compressed result;
+    result.crc32 = crc;
+    result.size = total;
+    result.ok = ok;
+    if (ok) result.data = std::move(collected);
+    collected = QByteArray();
+    return result;
+}
+
+ZipDeflate::Compressed ZipDeflate::compress(const QByteArray &data, int level) {
+    // miniz can't add an empty entry as compressed data
+    if (level == 0 || data.isEmpty()) {
+        Compressed result;
+        result.data = data;
+        result.crc32 = mz_uint32(mz_crc32(
+            MZ_CRC32_INIT, reinterpret_cast<const mz_uint8 *>(data.constData()),
+            size_t(data.size())));
+        result.size = quint64(data.size());
+        result.ok = true;
+        result.stored = true;
+        return result;
+    }
+    Stream stream(level);
+    stream.write(data);
+    return stream.finish();
+}
+
+bool ZipDeflate::addToZip(mz_zip_archive *zip, const char *name,
+                          const Compressed &entry) {
+    if (!entry.ok) return false;
+    if (entry.stored)
+        return mz_zip_writer_add_mem_ex(
+                   zip, name, entry.data.constData(), size_t(entry.data.size()),
+                   nullptr, 0, MZ_NO_COMPRESSION, 0, 0) != MZ_FALSE;
+    return mz_zip_writer_add_mem_ex_v2(
+               zip, name, entry.data.constData(), size_t(entry.data.size()),
+               nullptr, 0, MZ_ZIP_FLAG_COMPRESSED_DATA, entry.size,
+               entry.crc32, nullptr, nullptr, 0, nullptr, 0) != MZ_FALSE;
+}
+
+ZipDeflate::EntryWriter::EntryWriter(mz_zip_archive *zip, const char *name)
+    : zip(zip),
+      name(name),
+      dataOffset(zip->m_archive_size + LOCAL_HEADER_BYTES + std::strlen(name)) {}
+
+bool ZipDeflate::EntryWriter::write(const QByteArray &compressed) {
+    const size_t n = size_t(compressed.size());
+    ok = ok && zip->m_pWrite(zip->m_pIO_opaque, dataOffset + written,
+                             compressed.constData(), n) == n;
+    written += n;
+    return ok;
+}
+
+bool ZipDeflate::EntryWriter::finish(const Compressed &entry) {
+    if (!ok || !entry.ok) return false;
+
+    // miniz is given `this` as the entry's data: writeAround() lets every
+    // other write through, and only checks that one lands where write()
+    // already put the real data
+    archiveWrite = zip->m_pWrite;
+    archiveOpaque = zip->m_pIO_opaque;
+    zip->m_pWrite = &writeAround;
+    zip->m_pIO_opaque = this;
+    const bool added =
+        mz_zip_writer_add_mem_ex_v2(
+            zip, name.constData(), this, size_t(written), nullptr, 0,
+            MZ_ZIP_FLAG_COMPRESSED_DATA, entry.size, entry.crc32, nullptr,
+            nullptr, 0, nullptr, 0) != MZ_FALSE;
+    zip->m_pWrite = archiveWrite;
+    zip->m_pIO_opaque = archiveOpaque;
+    return added;
+}
+
+size_t ZipDeflate::EntryWriter::writeAround(void *opaque, mz_uint64 offset,
+                                            const void *data, size_t n) {
+    auto *self = static_cast<EntryWriter *>(opaque);
+    if (data == self)
+        // A zip64 extra field in the header would have moved the data
+        return offset == self->dataOffset && n == self->written ? n : 0;
+    return self->archiveWrite(self->archiveOpaque, offset, data, n);
+}
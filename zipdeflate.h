@@ -0,0 +1,122 @@
+#ifndef ZIPDEFLATE_H
+#define ZIPDEFLATE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QSharedPointer>
+
+#include <functional>
+
+#include "deflatebackend.h"
+#include "miniz.h"
+
+class QThreadPool;
+
+// Deflate for zip entries, done ahead of time so it can run on worker
+// threads, and the result added with addToZip().
+//
+// Input is cut into CHUNK_BYTES pieces, each compressed on its own by the
+// backend() and ended with a sync flush, so the pieces are independent
+// and their outputs concatenate into one valid deflate stream. Chunk
+// boundaries only depend on the input, never on the number of threads, so
+// the output is always the same bytes. (Matches found across a chunk
+// boundary are lost; at this size that costs 1-2% of ratio.) A backend
+// that can't flush only does the last piece; miniz does the others.
+namespace ZipDeflate {
+
+// Uncompressed bytes per independently compressed piece
+constexpr int CHUNK_BYTES = 256 * 1024;
+
+// An entry's contents, compressed
+struct Compressed {
+    QByteArray data;     // raw deflate stream
+    quint32 crc32 = 0;   // of the uncompressed contents
+    quint64 size = 0;    // uncompressed size
+    bool ok = false;
+    bool stored = false; // `data` is the contents themselves, not deflated
+};
+
+// Compresses bytes written to it in order. With a `pool`, each full chunk
+// is compressed there while the caller produces the next one; at most a
+// couple of chunks per thread are held at any time. Without one, chunks
+// are compressed on the calling thread as they fill.
+//
+// Compressed chunks are handed to `sink`, in order, as soon as they're
+// done, so the whole entry never has to be in memory; without a sink they
+// are collected for finish() to return.
+class Stream {
+public:
+    using Sink = std::function<bool(const QByteArray &compressed)>;
+
+    explicit Stream(int level, QThreadPool *workers = nullptr, Sink sink = {},
+                    const Backend &backend = ZipDeflate::backend());
+    ~Stream();
+
+    void write(const char *data, qsizetype size);
+    void write(const QByteArray &data) { write(data.constData(), data.size()); }
+
+    // Wait for every chunk and return the whole entry (its data empty if
+    // it went to the sink)
+    Compressed finish();
+
+private:
+    struct Chunk;
+
+    void submit(bool last);
+    // Pass finished chunks on, oldest first, waiting while more than
+    // `keep` are held
+    void drain(qsizetype keep);
+
+    QThreadPool *pool;
+    Sink sink;
+    const Backend &backend;   // for the last piece
+    const Backend &flushing;  // for the others: `backend` if it can flush
+    int level;
+    int maxInFlight;
+    QByteArray pending;  // the chunk being filled
+    QList<QSharedPointer<Chunk>> chunks; // submitted, not yet passed on
+    QByteArray collected; // output so far, without a sink
+    bool ok = true;
+    mz_uint32 crc = MZ_CRC32_INIT;
+    quint64 total = 0;
+};
+
+// Compress `data` in one go, on the calling thread. Level 0 stores it.
+Compressed compress(const QByteArray &data, int level);
+
+// Add `entry` to an archive being written, as already-compressed (or
+// stored) data
+bool addToZip(mz_zip_archive *zip, const char *name, const Compressed &entry);
+
+// Writes one entry's compressed data into an archive as it's produced, as
+// a Stream's sink, instead of holding all of it for addToZip(). The data
+// goes where miniz will expect it, after the local header; finish() then
+// has miniz write the header, data descriptor and central directory
+// record around it. Nothing else may be added to the archive in between,
+// and it must be opened without file alignment.
+class EntryWriter {
+public:
+    EntryWriter(mz_zip_archive *zip, const char *name);
+
+    bool write(const QByteArray &compressed);
+
+    // `entry` is the Stream's finish(): its crc32, size and ok
+    bool finish(const Compressed &entry);
+
+private:
+    // mz_file_write_func while finish() runs
+    static size_t writeAround(void *opaque, mz_uint64 offset, const void *data,
+                              size_t n);
+
+    mz_zip_archive *zip;
+    QByteArray name;
+    mz_uint64 dataOffset;
+    mz_uint64 written = 0;
+    bool ok = true;
+    mz_file_write_func archiveWrite = nullptr; // the archive's own, in finish()
+    void *archiveOpaque = nullptr;
+};
+
+} // namespace ZipDeflate
+
+#endif // ZIPDEFLATE_H